@@ -0,0 +1,274 @@
+// Microbenchmarks for the data-layer functions in server.c.
+//
+// Build from the repository root:
+//   gcc -O2 bench/bench.c -o bench/bench -lmicrohttpd -lpthread -lz -lm
+// Run:
+//   ./bench/bench [--dir=PATH] [rows ...]      (default rows: 10000 1000000 10000000)
+//
+// For each size it writes synthetic voters.txt / voted.txt / votes.txt into
+// PATH (default bench_data/, created if needed) and reports ns/op plus heap
+// allocations per op. The lookups and startup load are then repeated against
+// a voters.bin built from the same data. Allocations are counted for calls
+// made from server.c itself; stdio and zlib internals are not included.
+
+#ifdef __linux__
+    #define _GNU_SOURCE // Same upload code as the server (O_TMPFILE)
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// --- Allocation Counting ---
+static unsigned long long bench_alloc_calls = 0;
+static unsigned long long bench_alloc_bytes = 0;
+
+static void *bench_malloc(size_t size) {
+    __atomic_add_fetch(&bench_alloc_calls, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&bench_alloc_bytes, size, __ATOMIC_RELAXED);
+    return malloc(size);
+}
+
+static void *bench_calloc(size_t count, size_t size) {
+    __atomic_add_fetch(&bench_alloc_calls, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&bench_alloc_bytes, count * size, __ATOMIC_RELAXED);
+    return calloc(count, size);
+}
+
+static void *bench_realloc(void *ptr, size_t size) {
+    __atomic_add_fetch(&bench_alloc_calls, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&bench_alloc_bytes, size, __ATOMIC_RELAXED);
+    return realloc(ptr, size);
+}
+
+#define malloc(size) bench_malloc(size)
+#define calloc(count, size) bench_calloc(count, size)
+#define realloc(ptr, size) bench_realloc(ptr, size)
+#define main server_main
+#include "../server.c"
+#undef main
+#undef malloc
+#undef calloc
+#undef realloc
+
+#define BENCH_DEFAULT_DIR "bench_data"
+#define BENCH_NUM_CANDIDATES 5
+#define BENCH_QUERY_COUNT 4096
+#define BENCH_AADHAR_BASE 100000000000ULL
+#define BENCH_MIN_SECONDS 0.5
+
+typedef struct {
+    double ns_per_op;
+    double allocs_per_op;
+    double bytes_per_op;
+    long ops;
+} BenchResult;
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned long long bench_rng = 88172645463325252ULL;
+
+static unsigned long long next_random() {
+    bench_rng ^= bench_rng << 13;
+    bench_rng ^= bench_rng >> 7;
+    bench_rng ^= bench_rng << 17;
+    return bench_rng;
+}
+
+// --- Synthetic Data ---
+// Every second voter has voted; votes are spread round-robin over the candidates.
+static int write_dataset(long rows) {
+    FILE *candidates_file = fopen(CANDIDATES_FILE, "w");
+    FILE *voters_file = fopen(VOTERS_FILE, "w");
+    FILE *voted_file = fopen(VOTED_FILE, "w");
+    FILE *votes_file = fopen(VOTES_FILE, "w");
+    if (!candidates_file || !voters_file || !voted_file || !votes_file) {
+        perror("Failed to create benchmark data");
+        if (candidates_file) fclose(candidates_file);
+        if (voters_file) fclose(voters_file);
+        if (voted_file) fclose(voted_file);
+        if (votes_file) fclose(votes_file);
+        return 0;
+    }
+    for (int c = 1; c <= BENCH_NUM_CANDIDATES; c++) {
+        fprintf(candidates_file, "%d,Candidate %d,Party %d,/images/%d.jpeg\n", c, c, c, c);
+    }
+    for (long i = 0; i < rows; i++) {
+        unsigned long long aadhar = BENCH_AADHAR_BASE + (unsigned long long)i;
+        fprintf(voters_file, "%llu,Voter %ld\n", aadhar, i);
+        if (i % 2 == 0) {
+            fprintf(voted_file, "%llu\n", aadhar);
+            fprintf(votes_file, "%ld\n", (i / 2) % BENCH_NUM_CANDIDATES + 1);
+        }
+    }
+    fclose(candidates_file);
+    fclose(voters_file);
+    fclose(voted_file);
+    fclose(votes_file);
+    return 1;
+}
+
+// Lookup keys: three quarters registered, the rest unknown.
+static char queries[BENCH_QUERY_COUNT][20];
+static char query_names[BENCH_QUERY_COUNT][32];
+
+static void prepare_queries(long rows) {
+    for (int q = 0; q < BENCH_QUERY_COUNT; q++) {
+        long i = (long)(next_random() % (unsigned long long)rows);
+        if (q % 4 == 3) i += rows; // Not in the registry
+        snprintf(queries[q], sizeof(queries[q]), "%llu", BENCH_AADHAR_BASE + (unsigned long long)i);
+        snprintf(query_names[q], sizeof(query_names[q]), "Voter %ld", i);
+    }
+}
+
+// --- Benchmarks ---
+static volatile long bench_sink;
+
+static void op_is_voter_registered(long i) {
+    int q = (int)(i & (BENCH_QUERY_COUNT - 1));
+    bench_sink += is_voter_registered(queries[q], query_names[q]);
+}
+
+static void op_has_voted(long i) {
+    bench_sink += has_voted(queries[i & (BENCH_QUERY_COUNT - 1)]);
+}
+
+static void op_get_vote_counts(long i) {
+    (void)i;
+    get_vote_counts();
+}
+
+static void op_count_lines_in_file(long i) {
+    (void)i;
+    bench_sink += count_lines_in_file(VOTERS_FILE);
+}
+
+static void op_generate_voter_list_html(long i) {
+    (void)i;
+    PageBuffer page = {0};
+    generate_voter_page(&page, 0, VOTER_LIST_PREVIEW_LIMIT, VOTER_FILTER_ALL, 0);
+    bench_sink += (long)page.len;
+    page_free(&page);
+}
+
+static void op_generate_admin_dashboard_page(long i) {
+    (void)i;
+    PageBuffer page = {0};
+    generate_admin_dashboard_page(&page, ADMIN_PASS, NULL);
+    bench_sink += (long)page.len;
+    page_free(&page);
+}
+
+// Runs op in growing batches until BENCH_MIN_SECONDS have elapsed.
+static BenchResult run_benchmark(void (*op)(long)) {
+    BenchResult result = {0};
+    long batch = 1;
+    double elapsed = 0;
+    unsigned long long calls = 0, bytes = 0;
+    while (elapsed < BENCH_MIN_SECONDS) {
+        unsigned long long calls_before = bench_alloc_calls;
+        unsigned long long bytes_before = bench_alloc_bytes;
+        double start = now_seconds();
+        for (long i = 0; i < batch; i++) {
+            op(result.ops + i);
+        }
+        elapsed += now_seconds() - start;
+        calls += bench_alloc_calls - calls_before;
+        bytes += bench_alloc_bytes - bytes_before;
+        result.ops += batch;
+        if (batch < (1L << 24)) batch *= 2;
+    }
+    result.ns_per_op = elapsed * 1e9 / result.ops;
+    result.allocs_per_op = (double)calls / result.ops;
+    result.bytes_per_op = (double)bytes / result.ops;
+    return result;
+}
+
+static void report(const char *name, long rows, BenchResult r) {
+    printf("BENCH %-34s rows=%-9ld %14.1f ns/op %10.2f allocs/op %12.0f B/op  (%ld ops)\n",
+           name, rows, r.ns_per_op, r.allocs_per_op, r.bytes_per_op, r.ops);
+}
+
+static void run_size(long rows) {
+    if (!write_dataset(rows)) return;
+    prepare_queries(rows);
+
+    // Startup cost is measured once; it is what every restart pays
+    unsigned long long calls_before = bench_alloc_calls;
+    unsigned long long bytes_before = bench_alloc_bytes;
+    double start = now_seconds();
+    load_candidates();
+    get_vote_counts();
+    load_voter_registry();
+    load_voted_set();
+    double load_ns = (now_seconds() - start) * 1e9;
+    BenchResult startup = { load_ns, (double)(bench_alloc_calls - calls_before),
+                            (double)(bench_alloc_bytes - bytes_before), 1 };
+
+    report("startup_load", rows, startup);
+    report("is_voter_registered", rows, run_benchmark(op_is_voter_registered));
+    report("has_voted", rows, run_benchmark(op_has_voted));
+    report("get_vote_counts", rows, run_benchmark(op_get_vote_counts));
+    report("count_lines_in_file", rows, run_benchmark(op_count_lines_in_file));
+    report("generate_voter_list_html", rows, run_benchmark(op_generate_voter_list_html));
+    report("generate_admin_dashboard_page", rows, run_benchmark(op_generate_admin_dashboard_page));
+
+    // Same registry served from voters.bin
+    if (!convert_voter_registry()) return;
+    calls_before = bench_alloc_calls;
+    bytes_before = bench_alloc_bytes;
+    start = now_seconds();
+    load_voter_registry();
+    load_voted_set();
+    BenchResult mapped = { (now_seconds() - start) * 1e9, (double)(bench_alloc_calls - calls_before),
+                           (double)(bench_alloc_bytes - bytes_before), 1 };
+    report("startup_load_mapped", rows, mapped);
+    report("is_voter_registered_mapped", rows, run_benchmark(op_is_voter_registered));
+    report("has_voted_mapped", rows, run_benchmark(op_has_voted));
+    remove(VOTERS_BIN_FILE);
+}
+
+int main(int argc, char *argv[]) {
+    const char *dir = BENCH_DEFAULT_DIR;
+    long sizes[16];
+    int num_sizes = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--dir=", 6) == 0) {
+            dir = argv[i] + 6;
+        } else if (num_sizes < 16) {
+            long rows = atol(argv[i]);
+            if (rows <= 0) {
+                fprintf(stderr, "Invalid row count '%s'\n", argv[i]);
+                return 1;
+            }
+            sizes[num_sizes++] = rows;
+        }
+    }
+    if (num_sizes == 0) {
+        sizes[num_sizes++] = 10000;
+        sizes[num_sizes++] = 1000000;
+        sizes[num_sizes++] = 10000000;
+    }
+
+    #ifdef _WIN32
+        CreateDirectory(dir, NULL);
+    #else
+        mkdir(dir, 0755);
+    #endif
+    if (chdir(dir) != 0) {
+        perror("Failed to enter benchmark directory");
+        return 1;
+    }
+    strcpy(ADMIN_PASS, DEFAULT_ADMIN_PASS);
+    load_election_state();
+    load_election_name();
+
+    for (int i = 0; i < num_sizes; i++) {
+        run_size(sizes[i]);
+    }
+    return 0;
+}
@@ -1,15 +1,49 @@
+#ifdef __linux__
+    #define _GNU_SOURCE // O_TMPFILE for photo uploads
+#endif
+#ifdef _WIN32
+    #define _CRT_RAND_S // rand_s() for admin session tokens
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
 #include <microhttpd.h>
 #include <time.h>
 #include <math.h> // Added for sin/cos in doughnut chart
+#include <errno.h>
+#include <pthread.h> // Ballot ledger writer thread
+#include <zlib.h>    // gzip for cached pages
+#ifdef USE_BROTLI
+    #include <brotli/encode.h> // Optional: build with -DUSE_BROTLI ... -lbrotlienc
+#endif
+#ifdef USE_IO_URING
+    #include <linux/io_uring.h> // Optional: build with -DUSE_IO_URING (Linux only)
+    #include <sys/syscall.h>
+#endif
 
 // --- Cross-Platform Includes ---
 #ifdef _WIN32
     #include <winsock2.h>
+    #include <ws2tcpip.h> // For sockaddr_in6
     #include <windows.h> // For file locking & CreateDirectory
     #include <io.h>      // For _get_osfhandle
+    #include <fcntl.h>
+    #include <sys/stat.h>
+    #define fdatasync(fd) _commit(fd)
+    #define usleep(us) Sleep((DWORD)((us) / 1000))
+    #define localtime_r(timep, result) (localtime_s((result), (timep)) == 0 ? (result) : NULL)
+    #define gmtime_r(timep, result) (gmtime_s((result), (timep)) == 0 ? (result) : NULL)
+    #define strncasecmp _strnicmp
+    #define strcasecmp _stricmp
+    #ifndef S_ISREG
+        #define S_ISREG(m) (((m) & _S_IFMT) == _S_IFREG)
+    #endif
+    #define fseeko _fseeki64
+    #define ftello _ftelli64
 #else
     // On Linux, these headers are needed for networking and file locking
     #include <arpa/inet.h>
@@ -18,6 +52,8 @@
     #include <unistd.h>   // For fileno()
     #include <fcntl.h>    // For O_RDONLY
     #include <sys/stat.h> // For stat() and mkdir()
+    #include <strings.h>  // For strncasecmp()
+    #include <sys/mman.h> // For mapping voters.bin
 #endif
 
 // --- Feature Defines ---
@@ -28,18 +64,20 @@
 #define DEFAULT_ADMIN_PASS "admin123"
 #define DEFAULT_ELECTION_NAME "Online Voting Portal" 
 #define MAX_UPLOAD_SIZE (5 * 1024 * 1024) // 5 MB
+#define DEFAULT_THREAD_POOL_SIZE 4
 
 // --- File Paths ---
 #define CANDIDATES_FILE "candidates.txt"
 #define VOTERS_FILE "voters.txt"
-#define VOTED_FILE "voted.txt"
-#define VOTES_FILE "votes.txt"
+#define VOTED_FILE "voted.txt"   // Legacy: replayed at startup, no longer written
+#define VOTES_FILE "votes.txt"   // Legacy: replayed at startup, no longer written
+#define BALLOTS_FILE "ballots.log"   // Legacy: replayed at startup, no longer written
+#define LEDGER_DIR "ballots"         // Sharded ballot ledger segments
+#define CHECKPOINT_FILE "checkpoint.bin"
 #define ADMIN_PASS_FILE "admin.conf"
 #define ELECTION_STATUS_FILE "election_status.conf" 
 #define ELECTION_NAME_FILE "election_name.conf" 
-#define STATIC_DIR "."       
 #define UPLOAD_DIR "images"  
-#define TEMP_UPLOAD_FILE "images/upload.tmp" 
 
 // --- Data Structures ---
 typedef struct {
@@ -55,9 +93,16 @@ typedef struct {
     char name[100];
 } Voter;
 
-// Represents the state of a single connection
-struct connection_info_struct {
-    struct MHD_PostProcessor *postprocessor;
+// Every field any form posts; see Form Schemas for which routes take which
+enum form_field {
+    FIELD_AADHAR, FIELD_NAME, FIELD_CANDIDATE, FIELD_PASSWORD,
+    FIELD_ADD_ID, FIELD_ADD_NAME, FIELD_ADD_PARTY, FIELD_ADD_VOTER_AADHAR, FIELD_ADD_VOTER_NAME,
+    FIELD_ELECTION_NAME, FIELD_IMAGE_FILE, FIELD_VOTER_CSV,
+    NUM_FORM_FIELDS
+};
+
+// Fields and upload state of a POST form, only allocated once a POST is handled
+struct post_form {
     // Voter form
     char aadhar[20];
     char name[100];
@@ -74,1018 +119,4964 @@ struct connection_info_struct {
     // Admin "set name" form
     char election_name[100];
     
-    // File upload state
-    FILE *upload_file_handle;
-    char generated_filepath[256];
+    // File upload state, allocated when the photo part starts
+    struct PhotoUpload *photo_upload;
     char original_filename[256];
-    size_t total_upload_size;
     int error_flag; // 1=File Too Large, 2=Bad Type, 3=Write Error, 4=No File, 5=No ID/Name/Party
+
+    // Bulk voter import, allocated when the CSV part starts
+    struct VoterImport *voter_import;
+
+    const struct FormSchema *schema;
+    int admin_session; // Admin routes: the request carried a live session cookie
+    unsigned short field_len[NUM_FORM_FIELDS]; // Write cursors for the text fields
+    unsigned long long body_bytes;
+    int rejected; // HTTP status when the body broke the route's schema, else 0
+
+    struct post_form *next_free; // Pool link while unused
+};
+
+// Represents the state of a single request. Kept small, since every GET
+// needs one; both structs are recycled through the Connection State Pool.
+struct connection_info_struct {
+    struct MHD_PostProcessor *postprocessor;
+    struct post_form *form; // NULL until the request turns out to be a POST
+
+    // Ballot queued on the ledger while the connection is suspended
+    struct ballot_waiter *ballot;
+
+    // Request metrics
+    int route;
+    unsigned long long started_ns;
+    int admission; // Which in-flight count this request holds, released when it completes
+
+    struct connection_info_struct *next_free; // Pool link while unused
 };
 
 // --- Global Data ---
 Candidate *candidates = NULL; 
 int num_candidates = 0;
 int candidates_array_capacity = 0;
+int *candidate_slot_by_id = NULL; // Direct lookup: candidate id -> index into candidates (-1 if none)
+int candidate_id_table_size = 0;
+Voter *voter_records = NULL;      // Registered voters not in voters.bin, in voters.txt order (one per Aadhar)
+int num_registered_voters = 0;
+int voter_records_capacity = 0;
+int *voter_index_slots = NULL;    // Open-addressing hash: Aadhar -> index into voter_records
+size_t voter_index_capacity = 0;  // Always a power of two
+unsigned char *voted_bitmap = NULL; // One bit per registry index, set once they vote
+size_t voted_bitmap_bytes = 0;
+int num_voters_voted = 0;
 char ADMIN_PASS[100]; 
 char ELECTION_STATE[20]; 
 char ELECTION_NAME[100]; 
+unsigned long page_content_version = 1; // Bumped whenever something shown on a cached page changes
+time_t candidates_file_mtime = 0;       // candidates.txt as of the last load_candidates()
+off_t candidates_file_size = -1;
+
+// --- Global Data Locks ---
+// Lock order when more than one is held: checkpoint_mutex -> voters_lock ->
+// ledger shard mutexes (in shard order) -> candidates_lock. The ledger writer
+// takes candidates_lock for writing on every batch, so nothing slow (file
+// I/O, image_cache_lock) may run under it; pages render from
+// snapshot_candidates().
+pthread_rwlock_t candidates_lock = PTHREAD_RWLOCK_INITIALIZER; // candidates[], lookup table, tallies
+pthread_rwlock_t voters_lock = PTHREAD_RWLOCK_INITIALIZER;     // voter_records, index, voted_bitmap allocation
+pthread_rwlock_t election_lock = PTHREAD_RWLOCK_INITIALIZER;   // ELECTION_STATE, ELECTION_NAME
+
+void invalidate_page_cache() {
+    __atomic_add_fetch(&page_content_version, 1, __ATOMIC_RELEASE);
+}
+
+// Live results stream: the broadcaster thread sleeps on results_changed_cond
+// until results_version moves. results_stream_mutex is a leaf lock.
+unsigned long results_version = 1;
+pthread_mutex_t results_stream_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t results_changed_cond = PTHREAD_COND_INITIALIZER;
+
+void notify_results_changed() {
+    pthread_mutex_lock(&results_stream_mutex);
+    __atomic_add_fetch(&results_version, 1, __ATOMIC_RELEASE); // Also read lock-free by the results API cache
+    pthread_cond_signal(&results_changed_cond);
+    pthread_mutex_unlock(&results_stream_mutex);
+}
+
+// --- Metrics ---
+// Counters live in one ThreadMetrics block per thread. The owning thread
+// updates its block with relaxed load/store pairs (no locked instructions,
+// no shared cache lines) and /metrics sums all blocks at scrape time.
+// Blocks are registered once per thread and never freed, so counts from
+// threads that have exited are kept.
+enum metric_route {
+    ROUTE_INDEX, ROUTE_ADMIN, ROUTE_ADMIN_VOTERS, ROUTE_ADMIN_DASHBOARD, ROUTE_ADMIN_PANEL, ROUTE_IMAGES, ROUTE_API_RESULTS, ROUTE_RESULTS_STREAM, ROUTE_METRICS,
+    ROUTE_SUBMIT_VOTE, ROUTE_RESULTS, ROUTE_ADD_CANDIDATE, ROUTE_ADD_VOTER, ROUTE_IMPORT_VOTERS,
+    ROUTE_START_ELECTION, ROUTE_STOP_ELECTION, ROUTE_RESET_ELECTION, ROUTE_SET_ELECTION_NAME,
+    ROUTE_OTHER, NUM_ROUTES
+};
+static const char *route_labels[NUM_ROUTES] = {
+    "/", "/admin", "/admin/voters", "/admin/dashboard", "/admin/panel", "/images", "/api/results", "/results/stream", "/metrics",
+    "/submit_vote", "/results", "/add_candidate", "/add_voter", "/import_voters",
+    "/start_election", "/stop_election", "/reset_election", "/set_election_name",
+    "other"
+};
+
+enum metric_locked_file { LOCKED_CANDIDATES, LOCKED_VOTERS, LOCKED_VOTED, LOCKED_VOTES, LOCKED_BALLOTS, LOCKED_LEDGER, LOCKED_OTHER, NUM_LOCKED_FILES };
+static const char *locked_file_labels[NUM_LOCKED_FILES] = { CANDIDATES_FILE, VOTERS_FILE, VOTED_FILE, VOTES_FILE, BALLOTS_FILE, LEDGER_DIR, "other" };
+
+enum ballot_rejection { REJECT_NOT_LIVE, REJECT_NOT_REGISTERED, REJECT_ALREADY_VOTED, REJECT_NO_SELECTION, REJECT_WRITE_FAILED, NUM_REJECT_REASONS };
+static const char *rejection_labels[NUM_REJECT_REASONS] = { "not_live", "not_registered", "already_voted", "no_selection", "write_failed" };
+
+enum shed_reason { SHED_RATE_LIMITED, SHED_VOTES_SATURATED, SHED_RENDERS_SATURATED, NUM_SHED_REASONS };
+static const char *shed_labels[NUM_SHED_REASONS] = { "rate_limited", "votes_saturated", "renders_saturated" };
+
+// Upper bounds in seconds; one more implicit +Inf bucket follows
+static const double latency_bucket_bounds[] = { 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5 };
+#define NUM_LATENCY_BUCKETS ((int)(sizeof(latency_bucket_bounds) / sizeof(latency_bucket_bounds[0])) + 1)
+
+typedef struct ThreadMetrics {
+    unsigned long long requests[NUM_ROUTES];
+    unsigned long long latency_buckets[NUM_ROUTES][NUM_LATENCY_BUCKETS];
+    unsigned long long latency_ns[NUM_ROUTES];
+    unsigned long long lock_acquisitions[NUM_LOCKED_FILES];
+    unsigned long long lock_contended[NUM_LOCKED_FILES];
+    unsigned long long lock_wait_ns[NUM_LOCKED_FILES];
+    unsigned long long votes_committed;
+    unsigned long long ballot_batches;
+    unsigned long long ballots_rejected[NUM_REJECT_REASONS];
+    unsigned long long connections_opened;
+    unsigned long long connections_closed;
+    unsigned long long requests_shed[NUM_SHED_REASONS];
+    struct ThreadMetrics *next;
+} ThreadMetrics;
+
+ThreadMetrics *all_thread_metrics = NULL;
+ThreadMetrics fallback_thread_metrics; // Shared by threads whose block could not be allocated
+pthread_mutex_t thread_metrics_lock = PTHREAD_MUTEX_INITIALIZER;
+static _Thread_local ThreadMetrics *my_thread_metrics = NULL;
+
+static ThreadMetrics *thread_metrics() {
+    if (my_thread_metrics == NULL) {
+        ThreadMetrics *m = calloc(1, sizeof(ThreadMetrics));
+        if (m == NULL) return &fallback_thread_metrics;
+        pthread_mutex_lock(&thread_metrics_lock);
+        m->next = all_thread_metrics;
+        all_thread_metrics = m;
+        pthread_mutex_unlock(&thread_metrics_lock);
+        my_thread_metrics = m;
+    }
+    return my_thread_metrics;
+}
+
+// Only the owning thread writes a block, so a load/store pair cannot lose updates
+#define METRIC_ADD(field, n) do { \
+        ThreadMetrics *m_ = thread_metrics(); \
+        __atomic_store_n(&m_->field, __atomic_load_n(&m_->field, __ATOMIC_RELAXED) + (n), __ATOMIC_RELAXED); \
+    } while (0)
+
+static unsigned long long monotonic_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+
+void observe_request(int route, unsigned long long elapsed_ns) {
+    int bucket = 0;
+    while (bucket < NUM_LATENCY_BUCKETS - 1 && elapsed_ns > latency_bucket_bounds[bucket] * 1e9) bucket++;
+    METRIC_ADD(requests[route], 1);
+    METRIC_ADD(latency_buckets[route][bucket], 1);
+    METRIC_ADD(latency_ns[route], elapsed_ns);
+}
+
+static int classify_locked_file(const char *filename) {
+    for (int i = 0; i < LOCKED_OTHER; i++) {
+        if (strcmp(filename, locked_file_labels[i]) == 0) return i;
+    }
+    return LOCKED_OTHER;
+}
 
 // --- Utility: Cross-Platform File Locking ---
 #define LOCK_SHARED 1
 #define LOCK_EXCLUSIVE 2
 
-void lock_file(FILE *f, int lock_type) {
+// filename only labels the lock-wait metrics. An uncontended lock is taken
+// without blocking and costs no clock reads.
+void lock_fd(int fd, int lock_type, const char *filename) {
+    int which = classify_locked_file(filename);
     #ifdef _WIN32
-        HANDLE hFile = (HANDLE)_get_osfhandle(_fileno(f));
+        HANDLE hFile = (HANDLE)_get_osfhandle(fd);
         DWORD dwFlags = (lock_type == LOCK_EXCLUSIVE) ? LOCKFILE_EXCLUSIVE_LOCK : 0;
         OVERLAPPED overlapped = {0};
-        LockFileEx(hFile, dwFlags, 0, ~0, ~0, &overlapped);
+        if (!LockFileEx(hFile, dwFlags | LOCKFILE_FAIL_IMMEDIATELY, 0, ~0, ~0, &overlapped)) {
+            unsigned long long start = monotonic_ns();
+            LockFileEx(hFile, dwFlags, 0, ~0, ~0, &overlapped);
+            METRIC_ADD(lock_wait_ns[which], monotonic_ns() - start);
+            METRIC_ADD(lock_contended[which], 1);
+        }
     #else
         int flock_type = (lock_type == LOCK_EXCLUSIVE) ? LOCK_EX : LOCK_SH;
-        flock(fileno(f), flock_type);
+        if (flock(fd, flock_type | LOCK_NB) != 0) {
+            unsigned long long start = monotonic_ns();
+            flock(fd, flock_type);
+            METRIC_ADD(lock_wait_ns[which], monotonic_ns() - start);
+            METRIC_ADD(lock_contended[which], 1);
+        }
     #endif
+    METRIC_ADD(lock_acquisitions[which], 1);
 }
 
-void unlock_file(FILE *f) {
+void unlock_fd(int fd) {
     #ifdef _WIN32
-        HANDLE hFile = (HANDLE)_get_osfhandle(_fileno(f));
+        HANDLE hFile = (HANDLE)_get_osfhandle(fd);
         OVERLAPPED overlapped = {0};
         UnlockFileEx(hFile, 0, ~0, ~0, &overlapped);
     #else
-        flock(fileno(f), LOCK_UN);
+        flock(fd, LOCK_UN);
+    #endif
+}
+
+void lock_file(FILE *f, int lock_type, const char *filename) {
+    #ifdef _WIN32
+        lock_fd(_fileno(f), lock_type, filename);
+    #else
+        lock_fd(fileno(f), lock_type, filename);
+    #endif
+}
+
+void unlock_file(FILE *f) {
+    #ifdef _WIN32
+        unlock_fd(_fileno(f));
+    #else
+        unlock_fd(fileno(f));
     #endif
 }
 
 
 // --- Utility Functions (Data Handling) ---
-void load_candidates() {
-    if (candidates != NULL) {
-        free(candidates);
-        candidates = NULL;
+#define MAX_DIRECT_CANDIDATE_ID 65535 // Ids above this fall back to a linear search
+
+// Returns the index into candidates[] for this id, or -1 if there is none.
+// Caller holds candidates_lock.
+int find_candidate_slot(int candidate_id) {
+    if (candidate_id >= 0 && candidate_id < candidate_id_table_size) {
+        return candidate_slot_by_id[candidate_id];
     }
-    num_candidates = 0;
-    candidates_array_capacity = 0;
+    if (candidate_id >= 0 && candidate_id <= MAX_DIRECT_CANDIDATE_ID) {
+        return -1;
+    }
+    for (int i = 0; i < num_candidates; i++) {
+        if (candidates[i].id == candidate_id) return i;
+    }
+    return -1;
+}
+
+static void rebuild_candidate_lookup() {
+    free(candidate_slot_by_id);
+    candidate_slot_by_id = NULL;
+    candidate_id_table_size = 0;
+
+    int max_id = -1;
+    for (int i = 0; i < num_candidates; i++) {
+        if (candidates[i].id > max_id && candidates[i].id <= MAX_DIRECT_CANDIDATE_ID) {
+            max_id = candidates[i].id;
+        }
+    }
+    if (max_id < 0) return;
+
+    candidate_slot_by_id = malloc((size_t)(max_id + 1) * sizeof(int));
+    if (candidate_slot_by_id == NULL) {
+        perror("Failed to allocate candidate lookup table");
+        return;
+    }
+    for (int i = 0; i <= max_id; i++) {
+        candidate_slot_by_id[i] = -1;
+    }
+    // Walk backwards so the first candidate with a given id wins, as the old linear search did
+    for (int i = num_candidates - 1; i >= 0; i--) {
+        if (candidates[i].id >= 0 && candidates[i].id <= max_id) {
+            candidate_slot_by_id[candidates[i].id] = i;
+        }
+    }
+    candidate_id_table_size = max_id + 1;
+}
 
+// Parses candidates.txt into a private array, then swaps it in under the
+// write lock so concurrent readers never see a half-built list.
+void load_candidates() {
     FILE *file = fopen(CANDIDATES_FILE, "r");
     if (!file) {
         perror("Could not open candidates file");
         return;
     }
+    struct stat st;
+    if (fstat(fileno(file), &st) != 0) {
+        st.st_mtime = 0;
+        st.st_size = -1;
+    }
     printf("\n--- Loading Candidates ---\n");
     
+    Candidate *loaded = NULL;
+    int loaded_count = 0;
+    int loaded_capacity = 0;
     char line[512];
     while (fgets(line, sizeof(line), file)) {
-        if (num_candidates >= candidates_array_capacity) {
-            candidates_array_capacity += 10;
-            Candidate *new_candidates = realloc(candidates, candidates_array_capacity * sizeof(Candidate));
+        if (loaded_count >= loaded_capacity) {
+            loaded_capacity += 10;
+            Candidate *new_candidates = realloc(loaded, loaded_capacity * sizeof(Candidate));
             if (new_candidates == NULL) {
                 perror("Failed to reallocate memory for candidates");
-                free(candidates);
-                candidates = NULL;
+                free(loaded);
                 fclose(file);
                 return;
             }
-            candidates = new_candidates;
+            loaded = new_candidates;
         }
 
         // MODIFIED: sscanf now parses 4 fields (ID,Name,Party,ImageURL)
         if (sscanf(line, "%d,%99[^,],%99[^,],%255[^\n]", 
-                   &candidates[num_candidates].id, 
-                   candidates[num_candidates].name, 
-                   candidates[num_candidates].party, // NEW
-                   candidates[num_candidates].imageUrl) == 4) {
+                   &loaded[loaded_count].id, 
+                   loaded[loaded_count].name, 
+                   loaded[loaded_count].party, // NEW
+                   loaded[loaded_count].imageUrl) == 4) {
             
-            candidates[num_candidates].imageUrl[strcspn(candidates[num_candidates].imageUrl, "\r\n")] = 0;
+            loaded[loaded_count].imageUrl[strcspn(loaded[loaded_count].imageUrl, "\r\n")] = 0;
             printf("Loaded Candidate ID: %d, Name: %s, Party: %s, URL: %s\n", 
-                   candidates[num_candidates].id, 
-                   candidates[num_candidates].name,
-                   candidates[num_candidates].party, // NEW
-                   candidates[num_candidates].imageUrl);
+                   loaded[loaded_count].id, 
+                   loaded[loaded_count].name,
+                   loaded[loaded_count].party, // NEW
+                   loaded[loaded_count].imageUrl);
             
-            candidates[num_candidates].votes = 0;
-            num_candidates++;
+            loaded[loaded_count].votes = 0;
+            loaded_count++;
         }
     }
-    printf("--- Finished loading %d candidates ---\n\n", num_candidates);
+    printf("--- Finished loading %d candidates ---\n\n", loaded_count);
     fclose(file);
+
+    // Live tallies are carried over by id so reloading the list never loses counts
+    pthread_rwlock_wrlock(&candidates_lock);
+    Candidate *old_candidates = candidates;
+    int old_num_candidates = num_candidates;
+    candidates = loaded;
+    num_candidates = loaded_count;
+    candidates_array_capacity = loaded_capacity;
+    candidates_file_mtime = st.st_mtime;
+    candidates_file_size = st.st_size;
+    rebuild_candidate_lookup();
+    for (int i = 0; i < old_num_candidates; i++) {
+        int slot = find_candidate_slot(old_candidates[i].id);
+        if (slot != -1) candidates[slot].votes = old_candidates[i].votes;
+    }
+    pthread_rwlock_unlock(&candidates_lock);
+    free(old_candidates);
+    invalidate_page_cache();
+    notify_results_changed();
 }
 
-int is_voter_registered(const char* aadhar, const char* name) {
-    FILE* file = fopen(VOTERS_FILE, "r");
-    if (!file) return 0;
-    lock_file(file, LOCK_SHARED);
+// Picks up hand edits to candidates.txt without re-reading it on every request.
+void reload_candidates_if_changed() {
+    struct stat st;
+    if (stat(CANDIDATES_FILE, &st) != 0) return;
+    pthread_rwlock_rdlock(&candidates_lock);
+    int changed = (st.st_mtime != candidates_file_mtime || st.st_size != candidates_file_size);
+    pthread_rwlock_unlock(&candidates_lock);
+    if (changed) load_candidates();
+}
 
-    int found = 0;
-    char line[150];
-    while (fgets(line, sizeof(line), file)) {
-        char file_aadhar[20], file_name[100];
-        if (sscanf(line, "%19[^,],%99[^\n]", file_aadhar, file_name) == 2) {
-            file_name[strcspn(file_name, "\r\n")] = 0;
-            if (strcmp(file_aadhar, aadhar) == 0 && strcmp(file_name, name) == 0) {
-                found = 1;
-                break;
-            }
-        }
+// --- In-Memory Voter Registry ---
+// Voter indices run over the mapped binary registry first (see below), then
+// over voter_records, which holds voters.txt rows that are not in the
+// mapping: everything when there is no voters.bin, otherwise the rows
+// appended since it was built. voter_records is looked up through an
+// open-addressing hash (linear probing, load factor <= 0.5) keyed on Aadhar.
+#define VOTER_SLOT_EMPTY -1
+
+static unsigned int hash_aadhar(const char* aadhar) {
+    unsigned int h = 2166136261u; // FNV-1a
+    while (*aadhar) {
+        h ^= (unsigned char)*aadhar++;
+        h *= 16777619u;
     }
-    
-    unlock_file(file);
-    fclose(file);
-    return found;
+    return h;
 }
 
-int has_voted(const char* aadhar) {
-    FILE* file = fopen(VOTED_FILE, "r");
-    if (!file) return 0;
-    lock_file(file, LOCK_SHARED);
+#define HASH_BYTES_INIT 14695981039346656037ULL // FNV-1a 64
 
-    int found = 0;
-    char line[20];
-    while (fgets(line, sizeof(line), file)) {
-        line[strcspn(line, "\r\n")] = 0;
-        if (strcmp(line, aadhar) == 0) {
-            found = 1;
-            break;
-        }
+// Folds more bytes into a running hash_bytes() value.
+static unsigned long long hash_bytes_update(unsigned long long h, const char *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)data[i];
+        h *= 1099511628211ULL;
     }
-    
-    unlock_file(file);
-    fclose(file);
-    return found;
+    return h;
 }
 
-void record_vote(int candidate_id) {
-    FILE* file = fopen(VOTES_FILE, "a");
-    if (file) {
-        lock_file(file, LOCK_EXCLUSIVE);
-        fprintf(file, "%d\n", candidate_id);
-        unlock_file(file);
-        fclose(file);
-    }
+static unsigned long long hash_bytes(const char *data, size_t len) {
+    return hash_bytes_update(HASH_BYTES_INIT, data, len);
 }
 
-void record_voter_turnout(const char* aadhar) {
-    FILE* file = fopen(VOTED_FILE, "a");
-    if (file) {
-        lock_file(file, LOCK_EXCLUSIVE);
-        fprintf(file, "%s\n", aadhar);
-        unlock_file(file);
-        fclose(file);
+// --- Binary Voter Registry ---
+// voters.bin is built from voters.txt by "./server --convert-voters" and
+// mapped read-only at startup, so a large roll costs a page-cache mapping
+// rather than millions of sscanf calls. voters.txt stays the editable
+// source: rows appended after conversion are parsed from source_size on,
+// and a file whose first source_size bytes no longer hash the same is
+// ignored in favour of the text.
+//
+// Layout: header, records in voters.txt order, hash index, name pool.
+#define VOTERS_BIN_FILE "voters.bin"
+#define VOTER_REGISTRY_MAGIC "VOTRBIN2"
+#define FILE_HASH_CHUNK 65536
+#define VOTER_REGISTRY_SLOT_EMPTY 0xFFFFFFFFu
+#define AADHAR_PACK_MAX_DIGITS 17        // 10^17 fits below the 5-bit length tag
+
+typedef struct {
+    char magic[8];
+    uint32_t record_count;
+    uint32_t reserved;
+    uint64_t index_capacity;   // Slots in the hash index; a power of two
+    uint64_t records_offset;
+    uint64_t index_offset;
+    uint64_t names_offset;
+    uint64_t names_size;
+    uint64_t source_size;      // Bytes of voters.txt this file was built from
+    uint64_t source_hash;      // hash_bytes() of all of those bytes
+} VoterRegistryHeader;
+
+typedef struct {
+    uint64_t aadhar_key;       // pack_aadhar()
+    uint32_t name_offset;      // Into the name pool; names are NUL-terminated
+    uint32_t reserved;
+} VoterRegistryRecord;
+
+typedef struct {
+    void *base;
+    size_t size;
+    const VoterRegistryHeader *header;
+    const VoterRegistryRecord *records;
+    const uint32_t *index;
+    const char *names;
+} MappedRegistry;
+
+MappedRegistry mapped_registry = {0};
+int num_mapped_voters = 0;
+
+// Digits-only Aadhars of up to 17 digits pack as (length << 59) | value, so
+// leading zeros survive. Returns 0 for anything that cannot be packed.
+uint64_t pack_aadhar(const char *aadhar) {
+    size_t len = strlen(aadhar);
+    if (len == 0 || len > AADHAR_PACK_MAX_DIGITS) return 0;
+    uint64_t value = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (aadhar[i] < '0' || aadhar[i] > '9') return 0;
+        value = value * 10 + (uint64_t)(aadhar[i] - '0');
     }
+    return ((uint64_t)len << 59) | value;
 }
 
-void get_vote_counts() {
-    for (int i = 0; i < num_candidates; i++) {
-        candidates[i].votes = 0;
+void unpack_aadhar(uint64_t key, char out[20]) {
+    int len = (int)(key >> 59);
+    unsigned long long value = (unsigned long long)(key & ((1ULL << 59) - 1));
+    if (len > AADHAR_PACK_MAX_DIGITS) {
+        out[0] = '\0'; // pack_aadhar never makes such a key
+        return;
     }
-    FILE* file = fopen(VOTES_FILE, "r");
-    if (!file) return;
-    lock_file(file, LOCK_SHARED);
+    snprintf(out, 20, "%0*llu", len, value);
+}
 
-    int candidate_id;
-    while (fscanf(file, "%d", &candidate_id) == 1) {
-        for (int i = 0; i < num_candidates; i++) {
-            if (candidates[i].id == candidate_id) {
-                candidates[i].votes++;
-                break;
-            }
+static uint64_t hash_aadhar_key(uint64_t key) {
+    key ^= key >> 33; // MurmurHash3 finalizer
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key;
+}
+
+static void *map_file_readonly(const char *path, size_t *size_out) {
+    #ifdef _WIN32
+        HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE) return NULL;
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+            CloseHandle(file);
+            return NULL;
         }
-    }
-    
-    unlock_file(file);
-    fclose(file);
+        HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        CloseHandle(file);
+        if (mapping == NULL) return NULL;
+        void *base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping); // The view keeps the mapping alive
+        if (base == NULL) return NULL;
+        *size_out = (size_t)size.QuadPart;
+        return base;
+    #else
+        int fd = open(path, O_RDONLY);
+        if (fd == -1) return NULL;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            close(fd);
+            return NULL;
+        }
+        void *base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (base == MAP_FAILED) return NULL;
+        madvise(base, (size_t)st.st_size, MADV_RANDOM); // Lookups touch one record and one slot
+        *size_out = (size_t)st.st_size;
+        return base;
+    #endif
 }
 
-// MODIFIED: Function signature and fprintf now include party
-int add_new_candidate(const char* id, const char* name, const char* party, const char* image_url) {
-    if (id[0] == '\0' || name[0] == '\0' || party[0] == '\0' || image_url[0] == '\0') {
-        return 0;
-    }
-    
-    FILE* file = fopen(CANDIDATES_FILE, "a");
-    if (!file) {
-        perror("Failed to open candidates file for appending");
-        return 0;
+static void unmap_file(void *base, size_t size) {
+    #ifdef _WIN32
+        (void)size;
+        UnmapViewOfFile(base);
+    #else
+        munmap(base, size);
+    #endif
+}
+
+void unmap_voter_registry() {
+    if (mapped_registry.base != NULL) {
+        unmap_file(mapped_registry.base, mapped_registry.size);
     }
-    lock_file(file, LOCK_EXCLUSIVE);
-    
-    fseek(file, 0, SEEK_END);
-    long size = ftell(file);
-    if (size > 0) {
-        fprintf(file, "\n");
+    memset(&mapped_registry, 0, sizeof(mapped_registry));
+    num_mapped_voters = 0;
+}
+
+// Extends *hash, the hash_bytes() of a file's first `start` bytes, to its
+// first `end`. Every byte is covered, so an edit that keeps the length the
+// same is still caught.
+static int hash_file_range(FILE *file, uint64_t start, uint64_t end, uint64_t *hash) {
+    char buffer[FILE_HASH_CHUNK];
+    if (fseeko(file, (off_t)start, SEEK_SET) != 0) return 0;
+    unsigned long long h = *hash;
+    while (start < end) {
+        size_t len = (end - start > sizeof(buffer)) ? sizeof(buffer) : (size_t)(end - start);
+        if (fread(buffer, 1, len, file) != len) return 0;
+        h = hash_bytes_update(h, buffer, len);
+        start += len;
     }
-    
-    int id_num = atoi(id);
-    fprintf(file, "%d,%s,%s,%s", id_num, name, party, image_url);
-    
-    unlock_file(file);
-    fclose(file);
+    *hash = h;
     return 1;
 }
 
-int add_new_voter(const char* aadhar, const char* name) {
-    if (aadhar[0] == '\0' || name[0] == '\0') {
-        return 0;
-    }
+static int hash_file_prefix(FILE *file, uint64_t end, uint64_t *hash_out) {
+    *hash_out = HASH_BYTES_INIT;
+    return hash_file_range(file, 0, end, hash_out);
+}
 
-    FILE* file = fopen(VOTERS_FILE, "a");
-    if (!file) {
-        perror("Failed to open voters file for appending");
-        return 0;
+// Maps voters.bin if it was built from a prefix of the voters.txt open as
+// `source`. Returns 1 and fills mapped_registry, or 0 to fall back to text.
+// Caller holds voters_lock for writing and a lock on `source`.
+static int map_voter_registry(FILE *source) {
+    size_t size = 0;
+    void *base = map_file_readonly(VOTERS_BIN_FILE, &size);
+    if (base == NULL) return 0;
+
+    const VoterRegistryHeader *h = base;
+    const char *problem = NULL;
+    uint64_t source_size = 0, source_hash = 0;
+    if (size < sizeof(VoterRegistryHeader) || memcmp(h->magic, VOTER_REGISTRY_MAGIC, 8) != 0) {
+        problem = "not a voter registry file";
+    } else if (h->index_capacity == 0 || (h->index_capacity & (h->index_capacity - 1)) != 0
+               || h->record_count > INT_MAX || h->index_capacity < 2 * (uint64_t)h->record_count
+               || h->records_offset + (uint64_t)h->record_count * sizeof(VoterRegistryRecord) > size
+               || h->index_offset + h->index_capacity * sizeof(uint32_t) > size
+               || h->names_offset + h->names_size > size
+               || (h->names_size > 0 && ((const char *)base)[h->names_offset + h->names_size - 1] != '\0')) {
+        problem = "corrupt header";
+    } else if (fseeko(source, 0, SEEK_END) != 0 || (source_size = (uint64_t)ftello(source)) < h->source_size
+               || !hash_file_prefix(source, h->source_size, &source_hash) || source_hash != h->source_hash) {
+        problem = "voters.txt has changed since it was converted";
     }
-    lock_file(file, LOCK_EXCLUSIVE);
-    
-    fseek(file, 0, SEEK_END);
-    long size = ftell(file);
-    if (size > 0) {
-        fprintf(file, "\n");
+    if (problem != NULL) {
+        fprintf(stderr, "Ignoring %s (%s). Run ./server --convert-voters to rebuild it.\n", VOTERS_BIN_FILE, problem);
+        unmap_file(base, size);
+        return 0;
     }
-    
-    fprintf(file, "%s,%s", aadhar, name);
-    
-    unlock_file(file);
-    fclose(file);
+
+    mapped_registry.base = base;
+    mapped_registry.size = size;
+    mapped_registry.header = h;
+    mapped_registry.records = (const VoterRegistryRecord *)((const char *)base + h->records_offset);
+    mapped_registry.index = (const uint32_t *)((const char *)base + h->index_offset);
+    mapped_registry.names = (const char *)base + h->names_offset;
+    num_mapped_voters = (int)h->record_count;
     return 1;
 }
 
-// --- Election State & Name ---
-void load_election_state() {
-    FILE* file = fopen(ELECTION_STATUS_FILE, "r");
-    if (!file) {
-        strcpy(ELECTION_STATE, "PREP");
-        FILE* wfile = fopen(ELECTION_STATUS_FILE, "w");
-        if (wfile) {
-            fprintf(wfile, "PREP\n");
-            fclose(wfile);
-        }
-    } else {
-        if (fscanf(file, "%19s", ELECTION_STATE) != 1) {
-            strcpy(ELECTION_STATE, "PREP");
-        }
-        fclose(file);
+static int find_mapped_voter(const char *aadhar) {
+    uint64_t key = pack_aadhar(aadhar);
+    if (key == 0) return -1;
+    const VoterRegistryHeader *h = mapped_registry.header;
+    size_t mask = (size_t)h->index_capacity - 1;
+    size_t slot = hash_aadhar_key(key) & mask;
+    for (size_t probes = 0; probes <= mask; probes++) {
+        uint32_t rec = mapped_registry.index[slot];
+        if (rec == VOTER_REGISTRY_SLOT_EMPTY || rec >= h->record_count) return -1;
+        if (mapped_registry.records[rec].aadhar_key == key) return (int)rec;
+        slot = (slot + 1) & mask;
     }
-    printf("--- Election State Loaded: %s ---\n", ELECTION_STATE);
+    return -1;
 }
 
-void save_election_state(const char* state) {
-    FILE* file = fopen(ELECTION_STATUS_FILE, "w");
-    if (file) {
-        fprintf(file, "%s\n", state);
-        fclose(file);
-        strcpy(ELECTION_STATE, state);
-        printf("--- Election State Saved: %s ---\n", ELECTION_STATE);
-    } else {
-        perror("CRITICAL: Failed to save election state!");
+// Name of the voter at a registry index. Caller holds voters_lock.
+const char *voter_name(int idx) {
+    if (idx < num_mapped_voters) {
+        uint32_t offset = mapped_registry.records[idx].name_offset;
+        return (offset < mapped_registry.header->names_size) ? mapped_registry.names + offset : "";
     }
+    return voter_records[idx - num_mapped_voters].name;
 }
 
-void load_election_name() {
-    FILE* file = fopen(ELECTION_NAME_FILE, "r");
-    if (!file) {
-        strcpy(ELECTION_NAME, DEFAULT_ELECTION_NAME);
-        FILE* wfile = fopen(ELECTION_NAME_FILE, "w");
-        if (wfile) {
-            fprintf(wfile, "%s\n", DEFAULT_ELECTION_NAME);
-            fclose(wfile);
-        }
+// Aadhar of the voter at a registry index. Caller holds voters_lock.
+void voter_aadhar(int idx, char out[20]) {
+    if (idx < num_mapped_voters) {
+        unpack_aadhar(mapped_registry.records[idx].aadhar_key, out);
     } else {
-        if (fgets(ELECTION_NAME, sizeof(ELECTION_NAME), file) == NULL) {
-             strcpy(ELECTION_NAME, DEFAULT_ELECTION_NAME);
-        }
-        ELECTION_NAME[strcspn(ELECTION_NAME, "\r\n")] = 0;
-        fclose(file);
+        strcpy(out, voter_records[idx - num_mapped_voters].aadhar);
     }
-    printf("--- Election Name Loaded: %s ---\n", ELECTION_NAME);
 }
 
-void save_election_name(const char* name) {
-    FILE* file = fopen(ELECTION_NAME_FILE, "w");
-    if (file) {
-        fprintf(file, "%s\n", name);
-        fclose(file);
-        strcpy(ELECTION_NAME, name);
-        printf("--- Election Name Saved: %s ---\n", ELECTION_NAME);
-    } else {
-        perror("CRITICAL: Failed to save election name!");
+// Returns the registry index for this Aadhar, or -1 if not registered.
+// Caller holds voters_lock.
+int find_voter(const char* aadhar) {
+    if (num_mapped_voters > 0) {
+        int idx = find_mapped_voter(aadhar);
+        if (idx != -1) return idx;
     }
+    if (voter_index_capacity == 0) return -1;
+    size_t mask = voter_index_capacity - 1;
+    size_t slot = hash_aadhar(aadhar) & mask;
+    while (voter_index_slots[slot] != VOTER_SLOT_EMPTY) {
+        int i = voter_index_slots[slot];
+        if (strcmp(voter_records[i].aadhar, aadhar) == 0) {
+            return num_mapped_voters + i;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return -1;
 }
 
-
-int archive_votes_file() {
-    FILE* voted_file = fopen(VOTED_FILE, "w");
-    if (!voted_file) {
-        perror("Failed to clear voted.txt");
+static int rebuild_voter_index(size_t new_capacity) {
+    int *new_slots = malloc(new_capacity * sizeof(int));
+    if (new_slots == NULL) {
+        perror("Failed to allocate voter index");
         return 0;
     }
-    fclose(voted_file);
-
-    FILE* votes_file = fopen(VOTES_FILE, "r");
-    if (!votes_file) {
-        return 1;
-    }
-    fseek(votes_file, 0, SEEK_END);
-    if (ftell(votes_file) == 0) {
-        fclose(votes_file);
-        return 1;
+    for (size_t i = 0; i < new_capacity; i++) {
+        new_slots[i] = VOTER_SLOT_EMPTY;
     }
-    fclose(votes_file); 
-
-    char archive_filename[100];
-    time_t now = time(NULL);
-    struct tm *t = localtime(&now);
-    strftime(archive_filename, sizeof(archive_filename), "votes_archive_%Y%m%d_%H%M%S.txt", t);
-
-    if (rename(VOTES_FILE, archive_filename) != 0) {
-        perror("Failed to archive votes.txt");
-        return 0;
+    size_t mask = new_capacity - 1;
+    int num_records = num_registered_voters - num_mapped_voters;
+    for (int i = 0; i < num_records; i++) {
+        size_t slot = hash_aadhar(voter_records[i].aadhar) & mask;
+        while (new_slots[slot] != VOTER_SLOT_EMPTY) {
+            slot = (slot + 1) & mask;
+        }
+        new_slots[slot] = i;
     }
+    free(voter_index_slots);
+    voter_index_slots = new_slots;
+    voter_index_capacity = new_capacity;
+    return 1;
+}
 
-    FILE* new_votes_file = fopen(VOTES_FILE, "w");
-    if (!new_votes_file) {
-        perror("Failed to create new votes.txt");
+// Makes room in voted_bitmap for `total` voters. Caller holds voters_lock for writing.
+static int reserve_voted_bitmap(size_t total) {
+    size_t needed = (total + 7) / 8;
+    if (needed <= voted_bitmap_bytes) return 1;
+    unsigned char *new_bitmap = realloc(voted_bitmap, needed);
+    if (new_bitmap == NULL) {
+        perror("Failed to reallocate voted bitmap");
         return 0;
     }
-    fclose(new_votes_file);
-
+    memset(new_bitmap + voted_bitmap_bytes, 0, needed - voted_bitmap_bytes);
+    voted_bitmap = new_bitmap;
+    voted_bitmap_bytes = needed;
     return 1;
 }
 
-// --- Data Analytics Helper Functions ---
-int count_lines_in_file(const char *filename) {
-    FILE *file = fopen(filename, "r");
-    if (!file) return 0;
-    lock_file(file, LOCK_SHARED);
-    
-    int lines = 0;
-    int ch;
-    long char_count = 0;
-    int last_char = -1;
+// Adds a voter to the in-memory registry. The first entry for an Aadhar wins,
+// matching the order in which the old file scan found them.
+// Returns the voter's index, or -1 on allocation failure. Caller holds voters_lock for writing.
+int register_voter_in_memory(const char* aadhar, const char* name) {
+    int existing = find_voter(aadhar);
+    if (existing != -1) return existing;
 
-    while ((ch = fgetc(file)) != EOF) {
-        char_count++;
-        if (ch == '\n') {
-            lines++;
+    int num_records = num_registered_voters - num_mapped_voters;
+    if (num_records >= voter_records_capacity) {
+        int new_capacity = (voter_records_capacity == 0) ? 1024 : voter_records_capacity * 2;
+        Voter *new_records = realloc(voter_records, (size_t)new_capacity * sizeof(Voter));
+        if (new_records == NULL) {
+            perror("Failed to reallocate memory for voters");
+            return -1;
         }
-        last_char = ch;
+        voter_records = new_records;
+        if (!reserve_voted_bitmap((size_t)num_mapped_voters + (size_t)new_capacity)) return -1;
+        voter_records_capacity = new_capacity;
     }
-
-    if (char_count > 0 && last_char != '\n' && lines == 0) {
-         lines = 1; 
-    } else if (char_count > 0 && last_char != '\n') {
-         lines++;
+    if ((size_t)(num_records + 1) * 2 > voter_index_capacity) {
+        size_t new_capacity = (voter_index_capacity == 0) ? 2048 : voter_index_capacity * 2;
+        if (!rebuild_voter_index(new_capacity)) return -1;
     }
 
-    unlock_file(file);
-    fclose(file);
-    
-    return lines;
-}
+    Voter *v = &voter_records[num_records];
+    strncpy(v->aadhar, aadhar, sizeof(v->aadhar) - 1);
+    v->aadhar[sizeof(v->aadhar) - 1] = '\0';
+    strncpy(v->name, name, sizeof(v->name) - 1);
+    v->name[sizeof(v->name) - 1] = '\0';
 
-int get_registered_voter_count() {
-    return count_lines_in_file(VOTERS_FILE);
+    size_t mask = voter_index_capacity - 1;
+    size_t slot = hash_aadhar(v->aadhar) & mask;
+    while (voter_index_slots[slot] != VOTER_SLOT_EMPTY) {
+        slot = (slot + 1) & mask;
+    }
+    voter_index_slots[slot] = num_records;
+    num_registered_voters++;
+    return num_mapped_voters + num_records;
 }
 
-int get_cast_vote_count() {
-    return count_lines_in_file(VOTED_FILE);
+// Caller holds voters_lock for writing.
+void free_voter_registry() {
+    unmap_voter_registry();
+    free(voter_records);
+    free(voter_index_slots);
+    free(voted_bitmap);
+    voter_records = NULL;
+    voter_index_slots = NULL;
+    voted_bitmap = NULL;
+    voted_bitmap_bytes = 0;
+    num_registered_voters = 0;
+    num_voters_voted = 0;
+    voter_records_capacity = 0;
+    voter_index_capacity = 0;
 }
 
+void load_voter_registry() {
+    pthread_rwlock_wrlock(&voters_lock);
+    free_voter_registry();
 
-// --- HTML/SVG Generation ---
-#define PAGE_BUFFER_SIZE 65536 
-
-// MODIFIED: SVG Bar chart now includes party name
-void generate_results_svg(char *buffer, size_t buffer_size) {
-    get_vote_counts();
-    int max_votes = 0;
-    for (int i = 0; i < num_candidates; i++) {
-        if (candidates[i].votes > max_votes) max_votes = candidates[i].votes;
+    FILE* file = fopen(VOTERS_FILE, "r");
+    if (!file) {
+        perror("Could not open voters file");
+        pthread_rwlock_unlock(&voters_lock);
+        return;
     }
-    if (max_votes == 0) max_votes = 1;
+    lock_file(file, LOCK_SHARED, VOTERS_FILE);
 
-    int chart_width = 500;
-    int bar_height = 30;
-    int bar_spacing = 15;
-    int chart_height = (num_candidates > 0) ? (num_candidates * (bar_height + bar_spacing)) : (bar_height + bar_spacing);
+    // Rows covered by voters.bin are already indexed; only the rest is parsed
+    uint64_t text_start = 0;
+    if (map_voter_registry(file)) {
+        num_registered_voters = num_mapped_voters;
+        text_start = mapped_registry.header->source_size;
+        if (!reserve_voted_bitmap((size_t)num_mapped_voters)) {
+            unmap_voter_registry();
+            num_registered_voters = 0;
+            text_start = 0;
+        }
+    }
+    fseeko(file, (off_t)text_start, SEEK_SET);
 
-    char svg_buffer[8192] = {0};
-    char temp_buffer[1024];
+    char line[150];
+    while (fgets(line, sizeof(line), file)) {
+        char file_aadhar[20], file_name[100];
+        if (sscanf(line, "%19[^,],%99[^\n]", file_aadhar, file_name) == 2) {
+            file_name[strcspn(file_name, "\r\n")] = 0;
+            if (register_voter_in_memory(file_aadhar, file_name) == -1) break;
+        }
+    }
 
-    sprintf(svg_buffer, "<svg width='100%%' viewBox='0 0 %d %d' xmlns='http://www.w3.org/2000/svg' font-family='Inter, sans-serif'>"
-                      "<style>"
-                      ".bar-rect { transition: width 0.6s ease-out, fill 0.2s ease-in-out; fill: %s; }"
-                      ".bar-group:hover .bar-rect { fill: %s; }"
-                      "</style>", 
-                      chart_width, chart_height, "#3B82F6", "#2563EB");
+    unlock_file(file);
+    fclose(file);
+    pthread_rwlock_unlock(&voters_lock);
+    if (num_mapped_voters > 0) {
+        printf("--- Voter Registry Loaded: %d voters (%d mapped from %s) ---\n", num_registered_voters, num_mapped_voters, VOTERS_BIN_FILE);
+    } else {
+        printf("--- Voter Registry Loaded: %d voters ---\n", num_registered_voters);
+    }
+}
 
-    for (int i = 0; i < num_candidates; i++) {
-        // MODIFIED: bar_width calculation changed to allow more space for text
-        int bar_width = (int)(((float)candidates[i].votes / max_votes) * (chart_width - 250)); // Was -150
-        if (bar_width < 1) bar_width = 1;
-        int y_pos = i * (bar_height + bar_spacing);
+// Builds voters.bin from voters.txt ("./server --convert-voters"). The new
+// file is written beside the old one and renamed into place, so a running
+// server keeps its existing mapping. Returns 1 on success.
+int convert_voter_registry() {
+    FILE *source = fopen(VOTERS_FILE, "r");
+    if (!source) {
+        perror("Could not open voters file");
+        return 0;
+    }
+    lock_file(source, LOCK_SHARED, VOTERS_FILE);
 
-        // MODIFIED: Title and text now include party name
-        sprintf(temp_buffer, "<g class='bar-group' transform='translate(0 %d)'>"
-                             "<title>%s (%s): %d votes</title>"
-                             "<rect width='%d' height='%d' rx='6' class='bar-rect'></rect>"
-                             "<text x='%d' y='20' fill='#1F2937' font-size='14' font-weight='600'>%s (%s)</text>"
-                             "<text x='%d' y='20' fill='#1F2937' font-size='14' font-weight='bold'>%d</text>"
-                             "</g>", 
-                             y_pos, 
-                             candidates[i].name, candidates[i].party, candidates[i].votes,
-                             bar_width, bar_height,
-                             bar_width + 10, candidates[i].name, candidates[i].party,
-                             chart_width - 50, candidates[i].votes);
-        strcat(svg_buffer, temp_buffer);
+    VoterRegistryRecord *records = NULL;
+    size_t num_records = 0, records_capacity = 0;
+    char *names = NULL;
+    size_t names_len = 0, names_capacity = 0;
+    uint32_t *index = NULL;
+    int ok = 1;
+    long line_number = 0;
+    char line[150];
+    while (ok && fgets(line, sizeof(line), source)) {
+        line_number++;
+        char file_aadhar[20], file_name[100];
+        if (sscanf(line, "%19[^,],%99[^\n]", file_aadhar, file_name) != 2) continue;
+        file_name[strcspn(file_name, "\r\n")] = 0;
+        uint64_t key = pack_aadhar(file_aadhar);
+        if (key == 0) {
+            fprintf(stderr, "Line %ld: Aadhar '%s' is not 1-%d digits and cannot be stored in %s.\n",
+                    line_number, file_aadhar, AADHAR_PACK_MAX_DIGITS, VOTERS_BIN_FILE);
+            ok = 0;
+            break;
+        }
+        if (num_records == records_capacity) {
+            size_t new_capacity = records_capacity ? records_capacity * 2 : 65536;
+            VoterRegistryRecord *grown = realloc(records, new_capacity * sizeof(VoterRegistryRecord));
+            if (grown == NULL) {
+                perror("Failed to allocate voter records");
+                ok = 0;
+                break;
+            }
+            records = grown;
+            records_capacity = new_capacity;
+        }
+        size_t name_size = strlen(file_name) + 1;
+        if (names_len + name_size > UINT32_MAX) {
+            fprintf(stderr, "Voter names exceed the 4 GB name pool.\n");
+            ok = 0;
+            break;
+        }
+        if (names_len + name_size > names_capacity) {
+            size_t new_capacity = names_capacity ? names_capacity * 2 : 1 << 20;
+            char *grown = realloc(names, new_capacity);
+            if (grown == NULL) {
+                perror("Failed to allocate voter name pool");
+                ok = 0;
+                break;
+            }
+            names = grown;
+            names_capacity = new_capacity;
+        }
+        records[num_records].aadhar_key = key;
+        records[num_records].name_offset = (uint32_t)names_len;
+        records[num_records].reserved = 0;
+        memcpy(names + names_len, file_name, name_size);
+        names_len += name_size;
+        num_records++;
     }
-    
-    if (num_candidates == 0) {
-        sprintf(temp_buffer, "<text x='10' y='20' fill='#6B7280'>No candidates have been added yet.</text>");
-        strcat(svg_buffer, temp_buffer);
+    if (ok && num_records >= VOTER_REGISTRY_SLOT_EMPTY / 2) {
+        fprintf(stderr, "Too many voters for %s.\n", VOTERS_BIN_FILE);
+        ok = 0;
     }
 
-    strcat(svg_buffer, "</svg>");
-    strncpy(buffer, svg_buffer, buffer_size - 1);
-}
+    VoterRegistryHeader header;
+    memset(&header, 0, sizeof(header));
+    if (ok) {
+        memcpy(header.magic, VOTER_REGISTRY_MAGIC, 8);
+        if (fseeko(source, 0, SEEK_END) != 0) ok = 0;
+        header.source_size = (uint64_t)ftello(source);
+        ok = ok && hash_file_prefix(source, header.source_size, &header.source_hash);
+        if (!ok) perror("Failed to read voters file");
+    }
 
-// (generate_turnout_gauge_svg is unchanged)
-void generate_turnout_gauge_svg(char *buffer, size_t buffer_size, int cast_votes, int registered_voters) {
-    float turnout_percent = 0.0;
-    if (registered_voters > 0) {
-        turnout_percent = ((float)cast_votes / (float)registered_voters);
+    // Index the records, dropping repeated Aadhars (first one wins, as in load_voter_registry)
+    size_t kept = 0;
+    if (ok) {
+        header.index_capacity = 1024;
+        while (header.index_capacity < 2 * (uint64_t)num_records) header.index_capacity *= 2;
+        index = malloc((size_t)header.index_capacity * sizeof(uint32_t));
+        if (index == NULL) {
+            perror("Failed to allocate voter index");
+            ok = 0;
+        }
     }
-    if (turnout_percent > 1.0) turnout_percent = 1.0; 
+    if (ok) {
+        size_t mask = (size_t)header.index_capacity - 1;
+        for (size_t i = 0; i < (size_t)header.index_capacity; i++) index[i] = VOTER_REGISTRY_SLOT_EMPTY;
+        for (size_t i = 0; i < num_records; i++) {
+            size_t slot = hash_aadhar_key(records[i].aadhar_key) & mask;
+            int duplicate = 0;
+            while (index[slot] != VOTER_REGISTRY_SLOT_EMPTY) {
+                if (records[index[slot]].aadhar_key == records[i].aadhar_key) {
+                    duplicate = 1;
+                    break;
+                }
+                slot = (slot + 1) & mask;
+            }
+            if (duplicate) continue;
+            records[kept] = records[i];
+            index[slot] = (uint32_t)kept;
+            kept++;
+        }
+        header.record_count = (uint32_t)kept;
+        header.records_offset = sizeof(VoterRegistryHeader);
+        header.index_offset = header.records_offset + kept * sizeof(VoterRegistryRecord);
+        header.names_offset = header.index_offset + header.index_capacity * sizeof(uint32_t);
+        header.names_size = names_len;
+    }
+    unlock_file(source);
+    fclose(source);
 
-    int cx = 100, cy = 100, radius = 80, stroke_width = 20;
-    float circumference = M_PI * radius; 
-    float offset = circumference * (1.0 - turnout_percent);
-    
-    char svg_buffer[4096] = {0};
-    sprintf(svg_buffer,
-        "<svg width='100%%' viewBox='0 0 200 120' xmlns='http://www.w3.org/2000/svg' font-family='Inter, sans-serif'>"
-        " <style>"
-        "  .gauge-bg { fill: none; stroke: #E5E7EB; stroke-width: %d; }"
-        "  .gauge-fg { fill: none; stroke: #10B981; stroke-width: %d; stroke-dasharray: %f; stroke-dashoffset: %f; stroke-linecap: round; transition: stroke-dashoffset 0.8s ease-out; }"
-        "  .gauge-text { fill: #1F2937; font-size: 32px; font-weight: 800; text-anchor: middle; }"
-        "  .gauge-subtext { fill: #6B7280; font-size: 14px; font-weight: 500; text-anchor: middle; }"
-        " </style>"
-        " <path class='gauge-bg' d='M %d %d A %d %d 0 0 1 %d %d' />"
-        " <path class='gauge-fg' d='M %d %d A %d %d 0 0 1 %d %d' />"
-        " <text x='100' y='90' class='gauge-text'>%.0f%%</text>"
-        " <text x='100' y='110' class='gauge-subtext'>%d / %d Voters</text>"
-        "</svg>",
-        stroke_width, stroke_width, circumference, offset,
-        cx - radius, cy, radius, radius, cx + radius, cy,
-        cx - radius, cy, radius, radius, cx + radius, cy,
-        turnout_percent * 100.0,
-        cast_votes, registered_voters
-    );
-    strncpy(buffer, svg_buffer, buffer_size - 1);
+    if (ok) {
+        char temp_path[64];
+        snprintf(temp_path, sizeof(temp_path), "%s.tmp", VOTERS_BIN_FILE);
+        FILE *out = fopen(temp_path, "wb");
+        if (out == NULL) {
+            perror("Failed to create voter registry");
+            ok = 0;
+        } else {
+            ok = fwrite(&header, sizeof(header), 1, out) == 1
+              && fwrite(records, sizeof(VoterRegistryRecord), kept, out) == kept
+              && fwrite(index, sizeof(uint32_t), (size_t)header.index_capacity, out) == (size_t)header.index_capacity
+              && (names_len == 0 || fwrite(names, 1, names_len, out) == names_len);
+            ok = fflush(out) == 0 && ok;
+            ok = ok && fdatasync(fileno(out)) == 0;
+            ok = (fclose(out) == 0) && ok;
+            #ifdef _WIN32
+                if (ok) remove(VOTERS_BIN_FILE); // rename() does not replace on Windows
+            #endif
+            if (ok && rename(temp_path, VOTERS_BIN_FILE) != 0) ok = 0;
+            if (!ok) {
+                perror("Failed to write voter registry");
+                remove(temp_path);
+            }
+        }
+    }
+    if (ok) {
+        printf("Wrote %s: %zu voters (%zu duplicate rows skipped), %llu bytes of voters.txt.\n",
+               VOTERS_BIN_FILE, kept, num_records - kept, (unsigned long long)header.source_size);
+    }
+    free(records);
+    free(index);
+    free(names);
+    return ok;
 }
 
-// MODIFIED: Doughnut chart legend now includes party name
-void generate_doughnut_chart_svg(char *buffer, size_t buffer_size, int total_votes) {
-    float total_votes_safe = (total_votes == 0) ? 1.0 : (float)total_votes;
-    
-    const char *colors[] = {"#3B82F6", "#8B5CF6", "#10B981", "#F59E0B", "#EF4444", "#6366F1", "#EC4899", "#14B8A6"};
-    int num_colors = sizeof(colors) / sizeof(colors[0]);
+int is_voter_registered(const char* aadhar, const char* name) {
+    pthread_rwlock_rdlock(&voters_lock);
+    int idx = find_voter(aadhar);
+    int registered = idx != -1 && strcmp(voter_name(idx), name) == 0;
+    pthread_rwlock_unlock(&voters_lock);
+    return registered;
+}
 
-    int cx = 100, cy = 100, radius = 80, stroke_width = 20;
-    float circumference = 2 * M_PI * radius;
-    float current_offset = 0;
-    
-    char svg_buffer[8192] = {0};
-    char temp_buffer[1024];
-    
-    sprintf(svg_buffer,
-        "<div class='flex flex-col md:flex-row items-center justify-between gap-6'>"
-        " <div class='relative w-48 h-48'>"
-        "  <svg width='100%%' height='100%%' viewBox='0 0 200 200' xmlns='http://www.w3.org/2000/svg' style='transform: rotate(-90deg)'>"
-        "   <style>.slice { fill: none; stroke-width: %d; stroke-linecap: butt; transition: stroke-dashoffset 0.6s ease-out; }</style>",
-        stroke_width);
-    
-    for (int i = 0; i < num_candidates; i++) {
-        float percent = (float)candidates[i].votes / total_votes_safe;
-        float dash_length = circumference * percent;
-        float dash_gap = circumference - dash_length;
+// --- Voted Set ---
+// Bitmap over registry indices, rebuilt at startup and updated by the
+// ballot ledger, so the duplicate-vote check never reads disk. Bits are read
+// and written atomically under voters_lock held for reading.
+#define VOTED_BIT_IS_SET(idx) (__atomic_load_n(&voted_bitmap[(idx) >> 3], __ATOMIC_RELAXED) & (1u << ((idx) & 7)))
 
-        sprintf(temp_buffer,
-            "<circle class='slice' cx='%d' cy='%d' r='%d' stroke='%s' stroke-dasharray='%f %f' stroke-dashoffset='-%f' />",
-            cx, cy, radius, colors[i % num_colors], dash_length, dash_gap, current_offset);
-        strcat(svg_buffer, temp_buffer);
-        
-        current_offset += dash_length;
+static void mark_voter_voted(int idx) {
+    unsigned char bit = (unsigned char)(1u << (idx & 7));
+    if (!(__atomic_fetch_or(&voted_bitmap[idx >> 3], bit, __ATOMIC_RELAXED) & bit)) {
+        __atomic_fetch_add(&num_voters_voted, 1, __ATOMIC_RELAXED);
     }
-    
-    sprintf(temp_buffer,
-        "  </svg>"
-        "  <div class='absolute inset-0 flex flex-col items-center justify-center'>"
-        "   <span class='text-3xl font-extrabold text-gray-900'>%d</span>"
-        "   <span class='text-sm font-medium text-gray-500'>Total Votes</span>"
-        "  </div>"
-        " </div>"
-        " <div class='flex-grow pl-6 space-y-2'>",
-        total_votes);
-    strcat(svg_buffer, temp_buffer);
+}
 
-    for (int i = 0; i < num_candidates; i++) {
-        float percent = (float)candidates[i].votes / total_votes_safe * 100.0;
-        // MODIFIED: Legend now includes party name
-        sprintf(temp_buffer,
-            "<div class='flex items-center justify-between text-sm'>"
-            " <div class='flex items-center'>"
-            "  <span class='w-3 h-3 rounded-full mr-2' style='background-color: %s;'></span>"
-            "  <span class='font-medium text-gray-700'>%s (%s)</span>"
-            " </div>"
-            " <span class='font-bold text-gray-900'>%.0f%%</span>"
-            "</div>",
-            colors[i % num_colors], candidates[i].name, candidates[i].party, percent);
-        strcat(svg_buffer, temp_buffer);
-    }
-    
-    if (num_candidates == 0) {
-        strcat(svg_buffer, "<span class='text-sm text-gray-500'>No votes cast yet.</span>");
+static void unmark_voter_voted(int idx) {
+    unsigned char bit = (unsigned char)(1u << (idx & 7));
+    if (__atomic_fetch_and(&voted_bitmap[idx >> 3], (unsigned char)~bit, __ATOMIC_RELAXED) & bit) {
+        __atomic_fetch_sub(&num_voters_voted, 1, __ATOMIC_RELAXED);
     }
+}
 
-    strcat(svg_buffer, "</div></div>");
-    strncpy(buffer, svg_buffer, buffer_size - 1);
+// Caller holds voters_lock for writing.
+void clear_voted_set() {
+    if (voted_bitmap != NULL) {
+        memset(voted_bitmap, 0, voted_bitmap_bytes);
+    }
+    __atomic_store_n(&num_voters_voted, 0, __ATOMIC_RELAXED);
 }
 
-// (generate_voter_list_html is unchanged)
-void generate_voter_list_html(char *buffer, size_t buffer_size) {
-    FILE* file = fopen(VOTERS_FILE, "r");
+void load_voted_set() {
+    pthread_rwlock_wrlock(&voters_lock);
+    clear_voted_set();
+    FILE* file = fopen(VOTED_FILE, "r");
     if (!file) {
-        strcpy(buffer, "<p class='text-sm text-gray-500'>Could not load voters file.</p>");
+        pthread_rwlock_unlock(&voters_lock);
         return;
     }
-    lock_file(file, LOCK_SHARED);
-    
-    char list_html[4096] = "<ul class='space-y-2'>";
-    char temp_buffer[256];
-    char line[150];
-    int count = 0;
+    lock_file(file, LOCK_SHARED, VOTED_FILE);
 
+    int unknown = 0;
+    char line[32];
     while (fgets(line, sizeof(line), file)) {
-        char file_aadhar[20], file_name[100];
-        if (sscanf(line, "%19[^,],%99[^\n]", file_aadhar, file_name) == 2) {
-            file_name[strcspn(file_name, "\r\n")] = 0;
-            sprintf(temp_buffer, "<li class='flex justify-between items-center text-sm bg-gray-50 p-2 rounded'>"
-                                 " <span class='font-medium text-gray-700'>%s</span>"
-                                 " <span class='text-gray-500'>%s</span>"
-                                 "</li>", file_name, file_aadhar);
-            if (strlen(list_html) + strlen(temp_buffer) < sizeof(list_html) - 6) {
-                 strcat(list_html, temp_buffer);
-                 count++;
-            }
+        line[strcspn(line, "\r\n")] = 0;
+        if (line[0] == '\0') continue;
+        int idx = find_voter(line);
+        if (idx != -1) {
+            mark_voter_voted(idx);
+        } else {
+            unknown++;
         }
     }
-    
+
     unlock_file(file);
     fclose(file);
-    
-    if (count == 0) {
-        strcpy(buffer, "<p class='text-sm text-gray-500 text-center py-4'>No voters have been registered yet.</p>");
-    } else {
-        strcat(list_html, "</ul>");
-        strncpy(buffer, list_html, buffer_size - 1);
-    }
+    pthread_rwlock_unlock(&voters_lock);
+    printf("--- Voted Set Loaded: %d voters have voted", num_voters_voted);
+    if (unknown > 0) printf(" (%d unregistered entries ignored)", unknown);
+    printf(" ---\n");
 }
 
+int has_voted(const char* aadhar) {
+    pthread_rwlock_rdlock(&voters_lock);
+    int idx = find_voter(aadhar);
+    int voted = idx != -1 && VOTED_BIT_IS_SET(idx);
+    pthread_rwlock_unlock(&voters_lock);
+    return voted;
+}
 
-// (generate_html_shell is unchanged)
-const char* generate_html_shell(const char* title, const char* body, const char* active_page, const char* flash_message) {
-    static char page[PAGE_BUFFER_SIZE];
-    char nav_home_class[128] = "text-gray-700 font-medium hover:text-blue-600 transition duration-200";
-    char nav_admin_class[128] = "text-gray-700 font-medium hover:text-blue-600 transition duration-200";
-    char flash_html[512] = "";
-
-    if (active_page && 0 == strcmp(active_page, "Home")) {
-        strcpy(nav_home_class, "text-blue-600 font-bold");
-    } else if (active_page && 0 == strcmp(active_page, "Admin")) {
-        strcpy(nav_admin_class, "text-blue-600 font-bold");
+void clear_vote_counts() {
+    pthread_rwlock_wrlock(&candidates_lock);
+    for (int i = 0; i < num_candidates; i++) {
+        candidates[i].votes = 0;
     }
+    pthread_rwlock_unlock(&candidates_lock);
+    notify_results_changed();
+}
 
-    if (flash_message && flash_message[0] != '\0') {
-        const char* flash_bg = (strstr(flash_message, "Success") || strstr(flash_message, "added") || strstr(flash_message, "Started") || strstr(flash_message, "Stopped") || strstr(flash_message, "Reset") || strstr(flash_message, "Set")) 
-                               ? "bg-green-100 border-green-500 text-green-700" 
-                               : "bg-red-100 border-red-500 text-red-700";
-        sprintf(flash_html, 
-            "<div class='fade-in fixed top-20 left-1/2 -translate-x-1/2 z-[100] px-6 py-3 rounded-xl border %s shadow-lg'>"
-            " <p class='font-semibold'>%s</p>"
-            "</div>", flash_bg, flash_message);
+// Rebuilds candidates[].votes from the legacy votes.txt. Only needed at
+// startup; afterwards the ballot ledger keeps the tallies current.
+void get_vote_counts() {
+    clear_vote_counts();
+    FILE* file = fopen(VOTES_FILE, "r");
+    if (!file) return;
+    lock_file(file, LOCK_SHARED, VOTES_FILE);
+
+    int candidate_id;
+    pthread_rwlock_wrlock(&candidates_lock);
+    while (fscanf(file, "%d", &candidate_id) == 1) {
+        int slot = find_candidate_slot(candidate_id);
+        if (slot != -1) candidates[slot].votes++;
     }
+    pthread_rwlock_unlock(&candidates_lock);
+    
+    unlock_file(file);
+    fclose(file);
+}
 
-    const char* svg_logo = 
-        "<a href='/' class='flex items-center space-x-2'>"
-        " <svg class='w-8 h-8 text-indigo-700' xmlns='http://www.w3.org/2000/svg' viewBox='0 0 24 24' fill='currentColor'>"
-        "  <path d='M11.25 4.5A2.25 2.25 0 109 6.75V15h1.5V6.75A2.25 2.25 0 0011.25 4.5z' />"
-        "  <path fill-rule='evenodd' d='M12 2.25c-5.385 0-9.75 4.365-9.75 9.75s4.365 9.75 9.75 9.75 9.75-4.365 9.75-9.75S17.385 2.25 12 2.25zM9 15.75H6v-3a.75.75 0 00-1.5 0v3H3a.75.75 0 000 1.5h1.5v3a.75.75 0 001.5 0v-3h3a.75.75 0 000-1.5zm6-3.75a.75.75 0 100-1.5.75.75 0 000 1.5zM15 15a.75.75 0 100-1.5.75.75 0 000 1.5zM18 12a.75.75 0 100-1.5.75.75 0 000 1.5z' clip-rule='evenodd' />"
-        " </svg>"
-        " <span class='text-2xl font-bold text-indigo-700'>E-Voting</span>"
-        "</a>";
-        
-    sprintf(page,
-        "<!DOCTYPE html><html lang='en'><head><meta charset='UTF-8'><meta name='viewport' content='width=device-width, initial-scale=1.0'>"
-        "<title>%s</title><script src='https://cdn.tailwindcss.com'></script>"
-        "<link href='https://fonts.googleapis.com/css2?family=Inter:wght@400;500;600;700;800&display=swap' rel='stylesheet'>"
-        "<style>"
-        " body { font-family: 'Inter', sans-serif; padding-top: 80px; }"
-        " @keyframes fadeIn { from { opacity: 0; transform: translateY(20px); } to { opacity: 1; transform: translateY(0); } }"
-        " .fade-in { animation: fadeIn 0.8s ease-out forwards; }"
-        " .has-[:checked]:ring-2 { box-shadow: 0 0 0 2px #3B82F6; }"
-        " .backdrop-blur-xl { backdrop-filter: blur(24px); -webkit-backdrop-filter: blur(24px); }"
-        " summary { cursor: pointer; list-style: none; } "
-        " summary::-webkit-details-marker { display: none; } "
-        " details[open] summary .arrow { transform: rotate(90deg); } "
-        " .arrow { transition: transform 0.2s; display: inline-block; }"
-        " .aspect-\\[3\\/4\\] { aspect-ratio: 3 / 4; }" // NEW: Custom aspect ratio class
-        "</style></head>"
-        "<body class='bg-gradient-to-br from-slate-100 to-blue-50 min-h-screen p-4'>"
-        
-        "<nav class='fixed top-0 left-0 right-0 bg-white/70 backdrop-blur-xl shadow-lg z-50'>"
-        " <div class='max-w-6xl mx-auto px-4'>"
-        "  <div class='flex justify-between items-center h-16'>"
-        "   %s"
-        "   <div class='flex space-x-6'>"
-        "    <a href='/' class='%s'>Home</a>"
-        "    <a href='/admin' class='%s'>Admin</a>"
-        "   </div>"
-        "  </div>"
-        " </div>"
-        "</nav>"
-        
-        "%s" // Flash Message
-        "<main class='w-full'>%s</main>" // Page Content WRAPPED in main
-        "</body></html>",
-        title, svg_logo, nav_home_class, nav_admin_class, flash_html, body);
-    return page;
+// --- Ballot Ledger ---
+// Every ballot is one "aadhar,candidate_id\n" record, so a vote and its
+// turnout entry are written (or lost) together. The ledger is split into
+// shards by a hash of the Aadhar, each with its own lock, writer thread and
+// chain of segment files, so ballots in different shards never wait on each
+// other. A shard's writer gathers records from concurrent submitters into a
+// single write() + fdatasync() (group commit). submit_ballot only queues the
+// record: /submit_vote suspends its connection meanwhile, and the writer's
+// on_done callback resumes it once the batch is durable or has failed, so no
+// worker thread waits on the disk. record_ballot is the blocking form.
+//
+// Segments are named ballots/e<epoch>-s<shard>-<seq>.log and a shard moves
+// on to the next one once the current segment reaches LEDGER_SEGMENT_BYTES.
+// Archiving an election just seals the current epoch: ballots/epoch is
+// bumped, new segments start under it, and startup only replays segments of
+// the epoch it names.
+#define BALLOT_RECORD_MAX 64
+#define LEDGER_EPOCH_FILE LEDGER_DIR "/epoch"
+#define LEDGER_MAX_SHARDS 64
+#define DEFAULT_LEDGER_SHARDS 4
+#define LEDGER_SEGMENT_BYTES (16 * 1024 * 1024)
+
+enum ballot_result {
+    BALLOT_RECORDED = 0,
+    BALLOT_ALREADY_VOTED,
+    BALLOT_WRITE_FAILED,
+    BALLOT_PENDING // Queued; settles when the writer sets done
+};
+
+struct ballot_waiter {
+    int voter_idx;
+    int candidate_id;
+    int shard;
+    int done;
+    int ok;
+    void (*on_done)(struct ballot_waiter *waiter); // Called by the writer, under the shard lock
+    void *cls;
+    struct ballot_waiter *next;
+};
+
+// Where a shard's ledger ends: the segment being appended to and how many of
+// its bytes are reflected in the tallies. Also stored in checkpoints.
+typedef struct LedgerPosition {
+    uint32_t segment_seq;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t hash; // Of the segment up to offset; only filled in for checkpoints
+} LedgerPosition;
+
+typedef struct LedgerShard {
+    pthread_mutex_t mutex;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+    pthread_t thread;
+    int thread_running;
+    int stopping;
+    int writer_busy;
+    int fd;
+    LedgerPosition end;
+    char *pending;
+    size_t pending_len;
+    size_t pending_cap;
+    struct ballot_waiter *pending_waiters;
+    struct ballot_waiter **pending_tail;
+    struct ballot_waiter *inflight_waiters; // Batch the writer is syncing now
+} LedgerShard;
+
+// How long a writer lingers to let a batch fill before syncing. 0 still
+// batches naturally: records that arrive during an fdatasync share the next one.
+long ledger_commit_window_us = 0;
+int ledger_shard_count = DEFAULT_LEDGER_SHARDS;
+
+// Serializes checkpoint writes against each other and against archiving.
+// Taken before voters_lock.
+static pthread_mutex_t checkpoint_mutex = PTHREAD_MUTEX_INITIALIZER;
+// Segments from a run with more shards are still replayed, so every slot is
+// tracked even when only the first ledger_shard_count take new ballots.
+static LedgerShard ledger_shards[LEDGER_MAX_SHARDS];
+static pthread_once_t ledger_shards_once = PTHREAD_ONCE_INIT;
+static unsigned int ledger_epoch = 0;
+static unsigned long long ledger_batches_committed = 0; // Lets checkpoints skip idle periods
+
+static void init_ledger_shards() {
+    for (int i = 0; i < LEDGER_MAX_SHARDS; i++) {
+        LedgerShard *shard = &ledger_shards[i];
+        pthread_mutex_init(&shard->mutex, NULL);
+        pthread_cond_init(&shard->work_cond, NULL);
+        pthread_cond_init(&shard->done_cond, NULL);
+        shard->fd = -1;
+        shard->pending_tail = &shard->pending_waiters;
+    }
 }
 
-const char* generate_message_page(const char* title, const char* message, int is_success) {
-    char body[2048];
-    const char* success_svg = 
-        "<svg class='w-16 h-16 text-green-500 mx-auto' fill='none' stroke='currentColor' viewBox='0 0 24 24' xmlns='http://www.w3.org/2000/svg'>"
-        "<path stroke-linecap='round' stroke-linejoin='round' stroke-width='2' d='M9 12l2 2 4-4m6 2a9 9 0 11-18 0 9 9 0 0118 0z'></path></svg>";
-    const char* error_svg = 
-        "<svg class='w-16 h-16 text-red-500 mx-auto' fill='none' stroke='currentColor' viewBox='0 0 24 24' xmlns='http://www.w3.org/2000/svg'>"
-        "<path stroke-linecap='round' stroke-linejoin='round' stroke-width='2' d='M10 14l2-2m0 0l2-2m-2 2l-2-2m2 2l2 2m7-2a9 9 0 11-18 0 9 9 0 0118 0z'></path></svg>";
-    
-    sprintf(body,
-        "<div class='flex items-center justify-center' style='min-height: calc(100vh - 80px);'>"
-        "<div class='fade-in bg-white/70 backdrop-blur-xl rounded-2xl shadow-2xl p-8 max-w-lg text-center'>"
-        "<div class='mb-4'>%s</div>"
-        "<h1 class='text-3xl font-bold %s mb-4'>%s</h1>"
-        "<p class='text-gray-700 text-lg'>%s</p>"
-        "<div class='mt-8'><a href='/' class='text-blue-600 font-semibold hover:underline transition duration-200'>&larr; Go Back to Portal</a></div></div></div>",
-        is_success ? success_svg : error_svg,
-        is_success ? "text-gray-900" : "text-gray-900", title, message);
-    return generate_html_shell(title, body, "Message", NULL);
+static void ensure_ledger_shards() {
+    pthread_once(&ledger_shards_once, init_ledger_shards);
 }
 
-// MODIFIED: generate_voting_page now has 3:4 aspect ratio and displays party name
-const char *generate_voting_page() {
-    if (strcmp(ELECTION_STATE, "LIVE") != 0) {
-        const char* title = (strcmp(ELECTION_STATE, "PREP") == 0) ? "Voting Has Not Started" : "Voting Has Closed";
-        const char* message = (strcmp(ELECTION_STATE, "PREP") == 0) 
-            ? "The election is not yet open for voting. Please check back later." 
-            : "The voting period has ended. Results will be announced soon.";
-        
-        char body[2048];
-        const char* info_svg = 
-            "<svg class='w-16 h-16 text-blue-500 mx-auto' fill='none' stroke='currentColor' viewBox='0 0 24 24' xmlns='http://www.w3.org/2000/svg'>"
-            "<path stroke-linecap='round' stroke-linejoin='round' stroke-width='2' d='M13 16h-1v-4h-1m1-4h.01M21 12a9 9 0 11-18 0 9 9 0 0118 0z'></path></svg>";
-        
-        sprintf(body,
-            "<div class='flex items-center justify-center' style='min-height: calc(100vh - 80px);'>"
-            "<div class='fade-in bg-white/70 backdrop-blur-xl rounded-2xl shadow-2xl p-8 max-w-lg text-center'>"
-            "<div class='mb-4'>%s</div>"
-            "<h1 class='text-3xl font-bold text-gray-900 mb-4'>%s</h1>"
-            "<p class='text-gray-700 text-lg'>%s</p>"
-            "</div></div>", info_svg, title, message);
-        return generate_html_shell(title, body, "Home", NULL);
+// Only shards taking new ballots need locking to see a consistent cut; the
+// others are left as replay found them, and only archiving (which also holds
+// checkpoint_mutex) touches them.
+static void lock_ledger_shards() {
+    for (int s = 0; s < ledger_shard_count; s++) {
+        pthread_mutex_lock(&ledger_shards[s].mutex);
     }
+}
 
-    char body[16384];
-    char candidates_html[8192] = "";
-    char temp_buffer[2048];
+static void unlock_ledger_shards() {
+    for (int s = ledger_shard_count - 1; s >= 0; s--) {
+        pthread_mutex_unlock(&ledger_shards[s].mutex);
+    }
+}
 
-    for (int i = 0; i < num_candidates; i++) {
-        snprintf(temp_buffer, sizeof(temp_buffer),
-            "<label for='cand%d' class='flex flex-col bg-white/80 rounded-xl border border-gray-200 shadow-sm cursor-pointer transition duration-300 ease-in-out hover:shadow-lg hover:border-blue-400 hover:-translate-y-1 has-[:checked]:ring-2 has-[:checked]:ring-blue-500 has-[:checked]:border-blue-500 overflow-hidden'>" 
-            
-            // MODIFIED: aspect-video changed to aspect-[3/4]
-            "<img src='%s' alt='%s' class='w-full aspect-[3/4] object-cover' onerror=\"this.src='https://placehold.co/600x800/E0E7FF/3730A3?text=3:4+IMG'; this.onerror=null;\">"
-            
-            // MODIFIED: Added Party Name
-            "<div class='flex items-center justify-between p-4'>"
-            " <div>"
-            "  <span class='text-lg font-semibold text-gray-900'>%s</span>"
-            "  <p class='text-sm text-gray-500'>%s</p>" // NEW: Party name
-            " </div>"
-            "  <input id='cand%d' name='candidate' type='radio' value='%d' class='h-5 w-5 text-blue-600 border-gray-300 focus:ring-blue-500' required>"
-            "</div>"
-            "</label>",
-            candidates[i].id, 
-            candidates[i].imageUrl, candidates[i].name,
-            candidates[i].name,
-            candidates[i].party, // NEW
-            candidates[i].id, candidates[i].id
-        );
-        
-        if (strlen(candidates_html) + strlen(temp_buffer) < sizeof(candidates_html)) {
-            strcat(candidates_html, temp_buffer);
+static int ballot_shard(const char *aadhar) {
+    return (int)(hash_aadhar(aadhar) % (unsigned int)ledger_shard_count);
+}
+
+static void ledger_segment_path(char *out, size_t size, unsigned int epoch, int shard, uint32_t seq) {
+    snprintf(out, size, "%s/e%06u-s%02d-%06u.log", LEDGER_DIR, epoch, shard, (unsigned int)seq);
+}
+
+// Makes newly created segments survive a crash along with their contents.
+static void sync_ledger_dir() {
+    #ifndef _WIN32
+        int dir_fd = open(LEDGER_DIR, O_RDONLY);
+        if (dir_fd != -1) {
+            fsync(dir_fd);
+            close(dir_fd);
         }
-    }
-    
-    sprintf(body,
-        "<div class='container mx-auto p-4 md:p-8 max-w-3xl'>"
-        "<div class='fade-in bg-white/70 backdrop-blur-xl rounded-3xl shadow-2xl p-8 md:p-12'>"
-        "<h1 class='text-4xl font-extrabold text-center text-gray-900 mb-10'>%s</h1>" 
-        
-        "<div class='mb-10'><h2 class='text-2xl font-semibold mb-6 border-b border-gray-300 pb-3 text-gray-800'>Cast Your Vote</h2>"
-        "<form action='/submit_vote' method='POST' class='space-y-6'>"
-        "<div><label for='aadhar' class='block text-sm font-medium text-gray-700 mb-1'>Aadhar Number</label>"
-        "<input type='text' id='aadhar' name='aadhar' class='block w-full px-4 py-3 bg-white/80 border border-gray-300 rounded-xl shadow-sm focus:outline-none focus:ring-2 focus:ring-blue-500 focus:border-transparent' required></div>"
-        "<div><label for='name' class='block text-sm font-medium text-gray-700 mb-1'>Full Name</label>"
-        "<input type='text' id='name' name='name' class='block w-full px-4 py-3 bg-white/80 border border-gray-300 rounded-xl shadow-sm focus:outline-none focus:ring-2 focus:ring-blue-500 focus:border-transparent' required></div>"
-        
-        "<div><label class='block text-sm font-medium text-gray-700 mb-2'>Select a Candidate</label><div class='grid grid-cols-1 sm:grid-cols-2 gap-4'>%s</div></div>"
-        "<button type='submit' class='w-full bg-blue-600 text-white font-bold py-3 px-4 rounded-xl shadow-lg transform transition duration-200 hover:scale-105 hover:bg-blue-700 hover:shadow-xl focus:outline-none focus:ring-2 focus:ring-blue-500 focus:ring-offset-2'>Submit Vote</button></form></div>"
-        
-        "</div></div>",
-        ELECTION_NAME, candidates_html);
+    #endif
+}
 
-    return generate_html_shell("Online Voting Portal", body, "Home", NULL);
+static int open_segment_fd(int shard, uint32_t seq) {
+    char path[64];
+    ledger_segment_path(path, sizeof(path), ledger_epoch, shard, seq);
+    #ifdef _WIN32
+        int fd = _open(path, _O_WRONLY | _O_APPEND | _O_CREAT | _O_BINARY, _S_IREAD | _S_IWRITE);
+    #else
+        int fd = open(path, O_WRONLY | O_APPEND | O_CREAT, 0644);
+    #endif
+    if (fd != -1) sync_ledger_dir();
+    return fd;
 }
 
-const char *generate_admin_login_page() {
-    char body[4096];
-    sprintf(body,
-        "<div class='flex items-center justify-center' style='min-height: calc(100vh - 80px);'>"
-        "<div class='fade-in bg-white/70 backdrop-blur-xl rounded-3xl shadow-2xl p-8 md:p-12 max-w-md w-full'>"
-        "<h1 class='text-4xl font-extrabold text-center text-gray-900 mb-10'>Admin Login</h1>"
-        "<form action='/results' method='POST' class='space-y-6'>"
-        "<div><label for='password' class='block text-sm font-medium text-gray-700 mb-1'>Admin Password</label>"
-        "<input type='password' id='password' name='password' class='block w-full px-4 py-3 bg-white/80 border border-gray-300 rounded-xl shadow-sm focus:outline-none focus:ring-2 focus:ring-indigo-500 focus:border-transparent' required></div>"
-        "<button type='submit' class='w-full bg-indigo-600 text-white font-bold py-3 px-4 rounded-xl shadow-lg transform transition duration-200 hover:scale-105 hover:bg-indigo-700 hover:shadow-xl focus:outline-none focus:ring-2 focus:ring-indigo-500 focus:ring-offset-2'>Login</button></form>"
-        "</div></div>"
-    );
-    return generate_html_shell("Admin Login", body, "Admin", NULL);
+static unsigned int load_ledger_epoch() {
+    unsigned int epoch = 0;
+    FILE *file = fopen(LEDGER_EPOCH_FILE, "r");
+    if (file != NULL) {
+        if (fscanf(file, "%u", &epoch) != 1) epoch = 0;
+        fclose(file);
+    }
+    return epoch;
 }
 
-// MODIFIED: Admin dashboard now has new "Add Party" field
-const char *generate_admin_dashboard_page(const char* password, const char* flash_message) {
-    char body[32768]; 
-    char svg_bar_chart[8192];
-    char svg_gauge_chart[4096];
-    char svg_doughnut_chart[8192];
-    char voter_list_html[4096];
-    char winner_text[256];
-    
-    get_vote_counts();
-    int registered_voters = get_registered_voter_count();
-    int cast_votes = get_cast_vote_count();
-    
-    int total_votes = 0;
-    int max_votes = -1;
-    int winner_id = -1;
-    for(int i = 0; i < num_candidates; i++) {
-        total_votes += candidates[i].votes;
-        if (candidates[i].votes > max_votes) {
-            max_votes = candidates[i].votes;
-            winner_id = i;
+static int save_ledger_epoch(unsigned int epoch) {
+    char tmp_name[64];
+    snprintf(tmp_name, sizeof(tmp_name), "%s.tmp", LEDGER_EPOCH_FILE);
+    FILE *file = fopen(tmp_name, "w");
+    if (file == NULL) return 0;
+    int ok = fprintf(file, "%u\n", epoch) > 0 && fflush(file) == 0 && fdatasync(fileno(file)) == 0;
+    ok = (fclose(file) == 0) && ok;
+    ok = ok && rename(tmp_name, LEDGER_EPOCH_FILE) == 0;
+    if (!ok) remove(tmp_name);
+    else sync_ledger_dir();
+    return ok;
+}
+
+static int write_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return 0;
         }
+        data += n;
+        len -= (size_t)n;
     }
-    int tie = 0;
-    if(max_votes > 0) {
-        for(int i = 0; i < num_candidates; i++) {
-            if (i != winner_id && candidates[i].votes == max_votes) {
-                tie = 1;
-                break;
+    return 1;
+}
+
+#ifdef USE_IO_URING
+// Optional io_uring path for ledger commits (build with -DUSE_IO_URING on
+// Linux 5.6+). Each writer thread owns a small ring and submits a batch's
+// write and fdatasync as one linked pair, so a commit costs one system call.
+// If the kernel refuses the ring, or a submission fails, that writer falls
+// back to write() and fdatasync().
+typedef struct LedgerRing {
+    int fd;
+    unsigned *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_map, *cq_map;
+    size_t sq_map_len, cq_map_len, sqes_map_len;
+    uint64_t batches; // Tags each batch's completions
+} LedgerRing;
+
+static int ledger_ring_init(LedgerRing *ring) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = (int)syscall(__NR_io_uring_setup, 4, &params);
+    if (ring->fd < 0) return 0;
+
+    ring->sq_map_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_map_len = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_map_len > ring->sq_map_len) ring->sq_map_len = ring->cq_map_len;
+        ring->cq_map_len = ring->sq_map_len;
+    }
+    ring->sq_map = mmap(NULL, ring->sq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    ring->cq_map = (params.features & IORING_FEAT_SINGLE_MMAP) ? ring->sq_map
+        : mmap(NULL, ring->cq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    ring->sqes_map_len = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sq_map == MAP_FAILED || ring->cq_map == MAP_FAILED || ring->sqes == MAP_FAILED) {
+        if (ring->sq_map != MAP_FAILED) munmap(ring->sq_map, ring->sq_map_len);
+        if (ring->cq_map != MAP_FAILED && ring->cq_map != ring->sq_map) munmap(ring->cq_map, ring->cq_map_len);
+        if (ring->sqes != MAP_FAILED) munmap(ring->sqes, ring->sqes_map_len);
+        close(ring->fd);
+        ring->fd = -1;
+        return 0;
+    }
+    char *sq = ring->sq_map, *cq = ring->cq_map;
+    ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+    ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+    return 1;
+}
+
+static void ledger_ring_free(LedgerRing *ring) {
+    if (ring->fd < 0) return;
+    munmap(ring->sqes, ring->sqes_map_len);
+    if (ring->cq_map != ring->sq_map) munmap(ring->cq_map, ring->cq_map_len);
+    munmap(ring->sq_map, ring->sq_map_len);
+    close(ring->fd);
+    ring->fd = -1;
+}
+
+// Writes len bytes at offset and syncs them. Returns 1 when durable, 0 on an
+// I/O error, or -1 if nothing was written and the caller should write the
+// batch itself. A ring that can no longer be trusted is freed, which the
+// caller sees as ring->fd == -1.
+static int ledger_ring_commit(LedgerRing *ring, int fd, off_t offset, const char *data, size_t len) {
+    uint64_t batch = ++ring->batches;
+    unsigned tail = *ring->sq_tail; // Only this thread submits
+    unsigned mask = *ring->sq_mask;
+    struct io_uring_sqe *write_sqe = &ring->sqes[tail & mask];
+    memset(write_sqe, 0, sizeof(*write_sqe));
+    write_sqe->opcode = IORING_OP_WRITE;
+    write_sqe->flags = IOSQE_IO_LINK; // The sync only runs if the whole write succeeds
+    write_sqe->fd = fd;
+    write_sqe->addr = (uint64_t)(uintptr_t)data;
+    write_sqe->len = (uint32_t)len;
+    write_sqe->off = (uint64_t)offset;
+    write_sqe->user_data = batch * 2;
+    ring->sq_array[tail & mask] = tail & mask;
+    struct io_uring_sqe *sync_sqe = &ring->sqes[(tail + 1) & mask];
+    memset(sync_sqe, 0, sizeof(*sync_sqe));
+    sync_sqe->opcode = IORING_OP_FSYNC;
+    sync_sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+    sync_sqe->fd = fd;
+    sync_sqe->user_data = batch * 2 + 1;
+    ring->sq_array[(tail + 1) & mask] = (tail + 1) & mask;
+    __atomic_store_n(ring->sq_tail, tail + 2, __ATOMIC_RELEASE);
+
+    unsigned submitted = 0, reaped = 0;
+    long written = -1, synced = -1;
+    while (reaped < 2) {
+        long n = syscall(__NR_io_uring_enter, ring->fd, 2 - submitted, 2 - reaped, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (submitted == 0) {
+                __atomic_store_n(ring->sq_tail, tail, __ATOMIC_RELEASE);
+                ledger_ring_free(ring);
+                return -1;
+            }
+            // The kernel owns the batch now, so keep waiting for both
+            // completions rather than leave them to be reaped by the next one
+            if (errno == EAGAIN || errno == EBUSY) {
+                usleep(1000);
+                continue;
+            }
+            // Its fate is unknown; dropping the ring keeps the late completions away from later batches
+            ledger_ring_free(ring);
+            return 0;
+        }
+        submitted += (unsigned)n;
+        unsigned head = *ring->cq_head;
+        while (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+            struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+            if (cqe->user_data == batch * 2) {
+                written = cqe->res;
+                reaped++;
+            } else if (cqe->user_data == batch * 2 + 1) {
+                synced = cqe->res;
+                reaped++;
             }
+            head++;
         }
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
     }
-    if (tie) {
-        strcpy(winner_text, "There is currently a tie.");
-    } else if (winner_id != -1 && max_votes > 0) {
-        sprintf(winner_text, "Current Winner: <span class='font-bold text-blue-700'>%s (%s)</span> with %d votes", candidates[winner_id].name, candidates[winner_id].party, max_votes);
-    } else {
-        strcpy(winner_text, "No votes have been cast yet.");
+    if (written < 0) {
+        errno = (int)-written;
+        if (written != -EINVAL) return 0;
+        ledger_ring_free(ring); // This kernel lacks IORING_OP_WRITE
+        return -1;
+    }
+    if ((size_t)written < len) {
+        // A short write cancels the linked sync; finish the batch by hand
+        return write_all(fd, data + written, len - (size_t)written) && fdatasync(fd) == 0;
     }
+    if (synced < 0) errno = (int)-synced;
+    return synced == 0;
+}
+#endif
 
-    generate_turnout_gauge_svg(svg_gauge_chart, sizeof(svg_gauge_chart), cast_votes, registered_voters);
-    generate_doughnut_chart_svg(svg_doughnut_chart, sizeof(svg_doughnut_chart), total_votes);
-    generate_results_svg(svg_bar_chart, sizeof(svg_bar_chart));
-    generate_voter_list_html(voter_list_html, sizeof(voter_list_html));
-    
-    // MODIFIED: "Add Candidate" form now has "Party Name" field
-    const char* add_candidate_form = 
-        "<details class='bg-white/50 rounded-xl shadow-inner'>"
-        " <summary class='p-5 font-semibold text-lg text-gray-800 flex justify-between items-center cursor-pointer'>"
-        "  Add New Candidate"
-        "  <span class='arrow text-indigo-600'>&#9654;</span>"
-        " </summary>"
-        " <div class='p-6 border-t border-gray-200'>"
-        "  <form action='/add_candidate' method='POST' enctype='multipart/form-data' class='space-y-6'>"
-        "   <div><label for='add_id' class='block text-sm font-medium text-gray-700 mb-1'>Candidate ID (must be a number)</label>"
-        "   <input type='text' id='add_id' name='add_id' class='block w-full px-4 py-3 bg-white/80 border border-gray-300 rounded-xl shadow-sm focus:outline-none focus:ring-2 focus:ring-blue-500' required></div>"
-        "   <div><label for='add_name' class='block text-sm font-medium text-gray-700 mb-1'>Candidate Name</label>"
-        "   <input type='text' id='add_name' name='add_name' class='block w-full px-4 py-3 bg-white/80 border border-gray-300 rounded-xl shadow-sm focus:outline-none focus:ring-2 focus:ring-blue-500' required></div>"
-        "   <div><label for='add_party' class='block text-sm font-medium text-gray-700 mb-1'>Party Name</label>" // NEW
-        "   <input type='text' id='add_party' name='add_party' class='block w-full px-4 py-3 bg-white/80 border border-gray-300 rounded-xl shadow-sm focus:outline-none focus:ring-2 focus:ring-blue-500' required></div>" // NEW
-        "   <div><label for='add_image_file' class='block text-sm font-medium text-gray-700 mb-1'>Candidate Image (PNG or JPG)</label>"
-        "   <input type='file' id='add_image_file' name='add_image_file' accept='image/png, image/jpeg' class='block w-full text-sm text-gray-700 file:mr-4 file:py-2 file:px-4 file:rounded-lg file:border-0 file:text-sm file:font-semibold file:bg-indigo-50 file:text-indigo-700 hover:file:bg-indigo-100' required></div>"
-        "   <p class='text-xs text-gray-500'>Max file size: 5MB.</p>"
-        "   <input type='hidden' name='password' value='%s'>"
-        "   <button type='submit' class='w-full bg-green-600 text-white font-bold py-3 px-4 rounded-xl shadow-lg transform transition duration-200 hover:scale-105 hover:bg-green-700 hover:shadow-xl focus:outline-none focus:ring-2 focus:ring-green-500'>Add Candidate</button>"
-        "  </form>"
-        " </div>"
-        "</details>";
-    char add_candidate_form_with_pass[4096];
-    sprintf(add_candidate_form_with_pass, add_candidate_form, password); 
+static void *ledger_writer_main(void *arg) {
+    LedgerShard *shard = arg;
+    int shard_idx = (int)(shard - ledger_shards);
+    char *batch = NULL;
+    size_t batch_cap = 0;
+    #ifdef USE_IO_URING
+        LedgerRing ring;
+        int use_ring = ledger_ring_init(&ring);
+        if (!use_ring && shard_idx == 0) perror("io_uring unavailable; committing ballots with write()");
+    #endif
 
-    const char* add_voter_form_template = 
-        "<details class='bg-white/50 rounded-xl shadow-inner'>"
-        " <summary class='p-5 font-semibold text-lg text-gray-800 flex justify-between items-center cursor-pointer'>"
-        "  Add New Voter"
-        "  <span class='arrow text-indigo-600'>&#9654;</span>"
-        " </summary>"
-        " <div class='p-6 border-t border-gray-200'>"
-        "  <form action='/add_voter' method='POST' class='space-y-6'>"
-        "   <div><label for='add_voter_aadhar' class='block text-sm font-medium text-gray-700 mb-1'>Voter Aadhar</label>"
-        "   <input type='text' id='add_voter_aadhar' name='add_voter_aadhar' class='block w-full px-4 py-3 bg-white/80 border border-gray-300 rounded-xl shadow-sm focus:outline-none focus:ring-2 focus:ring-blue-500' required></div>"
-        "   <div><label for='add_voter_name' class='block text-sm font-medium text-gray-700 mb-1'>Voter Name</label>"
-        "   <input type='text' id='add_voter_name' name='add_voter_name' class='block w-full px-4 py-3 bg-white/80 border border-gray-300 rounded-xl shadow-sm focus:outline-none focus:ring-2 focus:ring-blue-500' required></div>"
-        "   <input type='hidden' name='password' value='%s'>"
-        "   <button type='submit' class='w-full bg-green-600 text-white font-bold py-3 px-4 rounded-xl shadow-lg transform transition duration-200 hover:scale-105 hover:bg-green-700 hover:shadow-xl focus:outline-none focus:ring-2 focus:ring-green-500'>Add Voter</button>"
-        "  </form>"
-        " </div>"
-        "</details>";
-    char add_voter_form[4096];
-    sprintf(add_voter_form, add_voter_form_template, password);
+    pthread_mutex_lock(&shard->mutex);
+    for (;;) {
+        while (shard->pending_len == 0 && !shard->stopping) {
+            pthread_cond_wait(&shard->work_cond, &shard->mutex);
+        }
+        if (shard->pending_len == 0) break; // Stopping with nothing left to flush
 
-    char election_control_html[2048];
-    char status_color[50];
-    if (strcmp(ELECTION_STATE, "LIVE") == 0) {
-        strcpy(status_color, "text-green-600"); 
-    } else if (strcmp(ELECTION_STATE, "CLOSED") == 0) {
-        strcpy(status_color, "text-red-600");
-    } else {
-        strcpy(status_color, "text-yellow-600"); 
-    }
-    sprintf(election_control_html, 
-        "<div class='bg-white/50 p-6 rounded-xl shadow-inner'>"
-        " <p class='text-center text-lg mb-4'>Current Status: <span class='font-bold %s'>%s</span></p>"
-        " <div class='grid grid-cols-3 gap-4'>"
-        "  <form action='/start_election' method='POST'>"
-        "   <input type='hidden' name='password' value='%s'>"
-        "   <button type='submit' class='w-full bg-green-600 text-white font-bold py-3 px-4 rounded-xl shadow-lg transform transition hover:scale-105 hover:bg-green-700' %s>START</button>"
-        "  </form>"
-        "  <form action='/stop_election' method='POST'>"
-        "   <input type='hidden' name='password' value='%s'>"
-        "   <button type='submit' class='w-full bg-red-600 text-white font-bold py-3 px-4 rounded-xl shadow-lg transform transition hover:scale-105 hover:bg-red-700' %s>STOP</button>"
-        "  </form>"
-        "  <form action='/reset_election' method='POST' onsubmit=\"return confirm('Are you sure you want to reset the election? This will archive all votes and clear the voter turnout list.');\">"
-        "   <input type='hidden' name='password' value='%s'>"
-        "   <button type='submit' class='w-full bg-gray-600 text-white font-bold py-3 px-4 rounded-xl shadow-lg transform transition hover:scale-105 hover:bg-gray-700' %s>RESET</button>"
-        "  </form>"
-        " </div>"
-        "</div>",
-        status_color, ELECTION_STATE, 
-        password, (strcmp(ELECTION_STATE, "LIVE") == 0) ? "disabled class='opacity-50 cursor-not-allowed w-full bg-green-600 text-white font-bold py-3 px-4 rounded-xl shadow-lg'" : "",
-        password, (strcmp(ELECTION_STATE, "LIVE") != 0) ? "disabled class='opacity-50 cursor-not-allowed w-full bg-red-600 text-white font-bold py-3 px-4 rounded-xl shadow-lg'" : "",
-        password, (strcmp(ELECTION_STATE, "LIVE") == 0) ? "disabled class='opacity-50 cursor-not-allowed w-full bg-gray-600 text-white font-bold py-3 px-4 rounded-xl shadow-lg'" : ""
-    );
+        shard->writer_busy = 1;
+        if (ledger_commit_window_us > 0 && !shard->stopping) {
+            pthread_mutex_unlock(&shard->mutex);
+            usleep((useconds_t)ledger_commit_window_us);
+            pthread_mutex_lock(&shard->mutex);
+        }
 
-    char election_settings_form[2048];
-    sprintf(election_settings_form,
-        "<div class='bg-white/50 p-6 rounded-xl shadow-inner'>"
-        " <form action='/set_election_name' method='POST' class='space-y-4'>"
-        "  <div><label for='election_name' class='block text-sm font-medium text-gray-700 mb-1'>Election Name</label>"
-        "  <input type='text' id='election_name' name='election_name' value='%s' class='block w-full px-4 py-3 bg-white/80 border border-gray-300 rounded-xl shadow-sm focus:outline-none focus:ring-2 focus:ring-blue-500' required></div>"
-        "  <input type='hidden' name='password' value='%s'>"
-        "  <button type='submit' class='w-full bg-blue-600 text-white font-bold py-3 px-4 rounded-xl shadow-lg transform transition duration-200 hover:scale-105 hover:bg-blue-700'>Set Name</button>"
-        " </form>"
-        "</div>",
-        ELECTION_NAME, password
-    );
+        // Swap buffers so submitters can keep queueing while this batch syncs
+        char *data = shard->pending;
+        size_t len = shard->pending_len;
+        size_t data_cap = shard->pending_cap;
+        struct ballot_waiter *waiters = shard->pending_waiters;
+        shard->pending = batch;
+        shard->pending_cap = batch_cap;
+        shard->pending_len = 0;
+        shard->pending_waiters = NULL;
+        shard->pending_tail = &shard->pending_waiters;
+        shard->inflight_waiters = waiters;
+        int fd = shard->fd;
+        LedgerPosition end = shard->end;
+        pthread_mutex_unlock(&shard->mutex);
 
-    sprintf(body,
-        "<div class='container mx-auto p-4 md:p-8 max-w-6xl'>"
-        "<div class='fade-in bg-white/70 backdrop-blur-xl rounded-3xl shadow-2xl p-8 md:p-12 w-full space-y-12'>"
-        "<h1 class='text-4xl font-extrabold text-gray-900 mb-0 text-center'>Admin Dashboard</h1>"
-        
-        "<section>"
-        " <h2 class='text-2xl font-semibold mb-6 border-b border-gray-300 pb-3 text-gray-800'>Data Analytics</h2>"
-        " <div class='grid grid-cols-1 md:grid-cols-2 gap-8'>"
-        "  <div class='bg-white/50 p-6 rounded-xl shadow-inner'>"
-        "   <h3 class='text-lg font-semibold text-gray-800 mb-4 text-center'>Voter Turnout</h3>"
+        // Roll over to a fresh segment once this one is full. The switch is
+        // only published if the batch lands, so a failure leaves end alone.
+        int new_fd = -1;
+        if (end.offset > 0 && end.offset + len > LEDGER_SEGMENT_BYTES) {
+            new_fd = open_segment_fd(shard_idx, end.segment_seq + 1);
+            if (new_fd != -1) {
+                fd = new_fd;
+                end.segment_seq++;
+                end.offset = 0;
+            } else {
+                perror("Failed to start a new ballot segment");
+            }
+        }
+
+        lock_fd(fd, LOCK_EXCLUSIVE, LEDGER_DIR);
+        off_t start = lseek(fd, 0, SEEK_END);
+        #ifdef USE_IO_URING
+            int ok = -1;
+            if (use_ring && start >= 0) {
+                ok = ledger_ring_commit(&ring, fd, start, data, len);
+                if (ring.fd == -1) {
+                    perror("io_uring commit failed; falling back to write()");
+                    use_ring = 0;
+                }
+            }
+            if (ok == -1) ok = write_all(fd, data, len) && fdatasync(fd) == 0;
+        #else
+            int ok = write_all(fd, data, len) && fdatasync(fd) == 0;
+        #endif
+        if (!ok) {
+            perror("CRITICAL: Failed to commit ballots");
+            // Drop any partial batch so the next append starts on a record boundary
+            if (start >= 0 && ftruncate(fd, start) != 0) perror("Failed to roll back ballot ledger");
+        }
+        unlock_fd(fd);
+
+        // Failed claims are released from the voted set, which needs the
+        // registry lock (taken before any shard lock) to keep the bitmap still
+        if (!ok) pthread_rwlock_rdlock(&voters_lock);
+        pthread_mutex_lock(&shard->mutex);
+        if (new_fd != -1) {
+            if (ok) {
+                close(shard->fd);
+                shard->fd = new_fd;
+            } else {
+                close(new_fd);
+            }
+        }
+        if (ok) {
+            int committed = 0;
+            pthread_rwlock_wrlock(&candidates_lock);
+            for (struct ballot_waiter *w = waiters; w != NULL; w = w->next) {
+                int slot = find_candidate_slot(w->candidate_id);
+                if (slot != -1) candidates[slot].votes++;
+                committed++;
+            }
+            pthread_rwlock_unlock(&candidates_lock);
+            end.offset = (uint64_t)start + len;
+            shard->end = end;
+            __atomic_add_fetch(&ledger_batches_committed, 1, __ATOMIC_RELAXED);
+            notify_results_changed();
+            METRIC_ADD(votes_committed, committed);
+            METRIC_ADD(ballot_batches, 1);
+        }
+        for (struct ballot_waiter *w = waiters, *next; w != NULL; w = next) {
+            // Released here rather than by the waiter, so under the shard lock
+            // the voted set only ever holds committed, pending or in-flight ballots
+            if (!ok && w->voter_idx != -1) unmark_voter_voted(w->voter_idx);
+            next = w->next; // w belongs to its submitter once done is set
+            w->ok = ok;
+            w->done = 1;
+            if (w->on_done != NULL) w->on_done(w);
+        }
+        if (!ok) pthread_rwlock_unlock(&voters_lock);
+        shard->inflight_waiters = NULL;
+        batch = data;
+        batch_cap = data_cap;
+        shard->writer_busy = 0;
+        pthread_cond_broadcast(&shard->done_cond);
+    }
+    pthread_mutex_unlock(&shard->mutex);
+    free(batch);
+    #ifdef USE_IO_URING
+        ledger_ring_free(&ring);
+    #endif
+    return NULL;
+}
+
+// Claims the voter and queues one ballot on their shard without waiting for
+// it. The voter is claimed in the voted set before the record is queued, so
+// two concurrent submissions for the same Aadhar can never both be
+// accepted: both hash to the same shard and the claim is made under its
+// lock. Returns BALLOT_PENDING once `waiter` is queued; the writer then sets
+// done (and calls on_done) when the ballot is durable or has failed, and
+// the waiter must stay valid until then.
+enum ballot_result submit_ballot(const char* aadhar, int candidate_id, struct ballot_waiter *waiter) {
+    char record[BALLOT_RECORD_MAX];
+    int record_len = snprintf(record, sizeof(record), "%s,%d\n", aadhar, candidate_id);
+    if (record_len <= 0 || record_len >= (int)sizeof(record)) return BALLOT_WRITE_FAILED;
+    ensure_ledger_shards();
+
+    // voters_lock keeps the bitmap from being reallocated under our claim
+    pthread_rwlock_rdlock(&voters_lock);
+    waiter->voter_idx = find_voter(aadhar);
+    waiter->candidate_id = candidate_id;
+    waiter->shard = ballot_shard(aadhar);
+    waiter->done = 0;
+    waiter->ok = 0;
+    waiter->next = NULL;
+    LedgerShard *shard = &ledger_shards[waiter->shard];
+
+    pthread_mutex_lock(&shard->mutex);
+    if (shard->fd == -1 || !shard->thread_running) {
+        pthread_mutex_unlock(&shard->mutex);
+        pthread_rwlock_unlock(&voters_lock);
+        return BALLOT_WRITE_FAILED;
+    }
+    if (waiter->voter_idx != -1) {
+        if (VOTED_BIT_IS_SET(waiter->voter_idx)) {
+            pthread_mutex_unlock(&shard->mutex);
+            pthread_rwlock_unlock(&voters_lock);
+            return BALLOT_ALREADY_VOTED;
+        }
+        mark_voter_voted(waiter->voter_idx);
+    }
+
+    if (shard->pending_len + (size_t)record_len > shard->pending_cap) {
+        size_t new_cap = (shard->pending_cap == 0) ? 4096 : shard->pending_cap * 2;
+        while (new_cap < shard->pending_len + (size_t)record_len) new_cap *= 2;
+        char *new_pending = realloc(shard->pending, new_cap);
+        if (new_pending == NULL) {
+            if (waiter->voter_idx != -1) unmark_voter_voted(waiter->voter_idx);
+            pthread_mutex_unlock(&shard->mutex);
+            pthread_rwlock_unlock(&voters_lock);
+            return BALLOT_WRITE_FAILED;
+        }
+        shard->pending = new_pending;
+        shard->pending_cap = new_cap;
+    }
+    memcpy(shard->pending + shard->pending_len, record, (size_t)record_len);
+    shard->pending_len += (size_t)record_len;
+    *shard->pending_tail = waiter;
+    shard->pending_tail = &waiter->next;
+    pthread_cond_signal(&shard->work_cond);
+    pthread_mutex_unlock(&shard->mutex);
+    pthread_rwlock_unlock(&voters_lock);
+    return BALLOT_PENDING;
+}
+
+// Blocks until a ballot queued by submit_ballot has settled.
+void wait_for_ballot(struct ballot_waiter *waiter) {
+    LedgerShard *shard = &ledger_shards[waiter->shard];
+    pthread_mutex_lock(&shard->mutex);
+    while (!waiter->done) {
+        pthread_cond_wait(&shard->done_cond, &shard->mutex);
+    }
+    pthread_mutex_unlock(&shard->mutex);
+}
+
+// Appends one ballot and waits for it to be durable.
+enum ballot_result record_ballot(const char* aadhar, int candidate_id) {
+    struct ballot_waiter waiter = { 0 };
+    enum ballot_result result = submit_ballot(aadhar, candidate_id, &waiter);
+    if (result != BALLOT_PENDING) return result;
+    wait_for_ballot(&waiter);
+    return waiter.ok ? BALLOT_RECORDED : BALLOT_WRITE_FAILED;
+}
+
+// Applies one ledger file from byte `start` to the tallies and voted set.
+// A record without its trailing newline was torn by a crash mid-write and is
+// cut off so later appends start on a clean line. Returns the ballots
+// replayed, or -1 if the file does not exist. Caller holds voters_lock for
+// reading and candidates_lock for writing.
+static int replay_ballot_file(const char *path, uint64_t start, uint64_t *end_out) {
+    FILE* file = fopen(path, "r");
+    if (!file) return -1;
+    lock_file(file, LOCK_SHARED, strcmp(path, BALLOTS_FILE) == 0 ? BALLOTS_FILE : LEDGER_DIR);
+
+    int replayed = 0;
+    off_t valid_end = (off_t)start;
+    fseeko(file, valid_end, SEEK_SET);
+    char line[BALLOT_RECORD_MAX];
+    while (fgets(line, sizeof(line), file)) {
+        size_t len = strlen(line);
+        if (len == 0 || line[len - 1] != '\n') break;
+        valid_end = ftello(file);
+
+        char aadhar[20];
+        int candidate_id;
+        if (sscanf(line, "%19[^,],%d", aadhar, &candidate_id) != 2) continue;
+        int idx = find_voter(aadhar);
+        if (idx != -1) {
+            if (VOTED_BIT_IS_SET(idx)) continue;
+            mark_voter_voted(idx);
+        }
+        int slot = find_candidate_slot(candidate_id);
+        if (slot != -1) candidates[slot].votes++;
+        replayed++;
+    }
+    fseeko(file, 0, SEEK_END);
+    off_t file_size = ftello(file);
+
+    unlock_file(file);
+    fclose(file);
+
+    if (file_size > valid_end) {
+        fprintf(stderr, "Truncating %lld bytes of incomplete ballot data from %s\n", (long long)(file_size - valid_end), path);
+        if (truncate(path, valid_end) != 0) {
+            perror("Failed to truncate ballot ledger");
+        }
+    }
+    if (end_out != NULL) *end_out = (uint64_t)valid_end;
+    return replayed;
+}
+
+// Replays the single-file ballots.log written by older versions. Like
+// votes.txt it is only read at startup, and set aside by the next archive.
+void replay_legacy_ballots() {
+    pthread_rwlock_rdlock(&voters_lock);
+    pthread_rwlock_wrlock(&candidates_lock);
+    int replayed = replay_ballot_file(BALLOTS_FILE, 0, NULL);
+    pthread_rwlock_unlock(&candidates_lock);
+    pthread_rwlock_unlock(&voters_lock);
+    if (replayed >= 0) {
+        printf("--- Legacy Ballot Log Replayed: %d ballots ---\n", replayed);
+    }
+}
+
+// Applies the current epoch's segments, each shard from `from[shard]` (where
+// a checkpoint left off) or from the beginning when `from` is NULL, and
+// leaves every shard positioned at the end of its last segment.
+void replay_ballot_ledger(const LedgerPosition *from) {
+    ensure_ledger_shards();
+    ledger_epoch = load_ledger_epoch();
+    pthread_rwlock_rdlock(&voters_lock);
+    pthread_rwlock_wrlock(&candidates_lock);
+
+    int replayed = 0, segments = 0;
+    LedgerPosition ends[LEDGER_MAX_SHARDS];
+    for (int s = 0; s < LEDGER_MAX_SHARDS; s++) {
+        LedgerPosition end = { 0, 0, 0, 0 };
+        if (from != NULL) {
+            end.segment_seq = from[s].segment_seq;
+            end.offset = from[s].offset;
+        }
+        for (uint32_t seq = end.segment_seq; ; seq++) {
+            char path[64];
+            ledger_segment_path(path, sizeof(path), ledger_epoch, s, seq);
+            uint64_t start = (seq == end.segment_seq) ? end.offset : 0;
+            uint64_t valid_end = 0;
+            int n = replay_ballot_file(path, start, &valid_end);
+            if (n < 0) break;
+            replayed += n;
+            segments++;
+            end.segment_seq = seq;
+            end.offset = valid_end;
+        }
+        ends[s] = end;
+    }
+    pthread_rwlock_unlock(&candidates_lock);
+    pthread_rwlock_unlock(&voters_lock);
+    for (int s = 0; s < LEDGER_MAX_SHARDS; s++) {
+        pthread_mutex_lock(&ledger_shards[s].mutex);
+        ledger_shards[s].end = ends[s];
+        pthread_mutex_unlock(&ledger_shards[s].mutex);
+    }
+    if (from != NULL) {
+        printf("--- Ballot Ledger Replayed: %d ballots after the checkpoint (epoch %u) ---\n", replayed, ledger_epoch);
+    } else {
+        printf("--- Ballot Ledger Replayed: %d ballots from %d segments (epoch %u) ---\n", replayed, segments, ledger_epoch);
+    }
+}
+
+static int start_ledger_shard(int s) {
+    LedgerShard *shard = &ledger_shards[s];
+    shard->fd = open_segment_fd(s, shard->end.segment_seq);
+    if (shard->fd == -1) {
+        perror("Failed to open ballot ledger segment");
+        return 0;
+    }
+    shard->stopping = 0;
+    if (pthread_create(&shard->thread, NULL, ledger_writer_main, shard) != 0) {
+        perror("Failed to start ballot ledger writer");
+        close(shard->fd);
+        shard->fd = -1;
+        return 0;
+    }
+    shard->thread_running = 1;
+    return 1;
+}
+
+// Flushes anything still queued, then stops every shard's writer thread.
+void close_ballot_ledger() {
+    ensure_ledger_shards();
+    for (int s = 0; s < LEDGER_MAX_SHARDS; s++) {
+        LedgerShard *shard = &ledger_shards[s];
+        if (!shard->thread_running) continue;
+        pthread_mutex_lock(&shard->mutex);
+        shard->stopping = 1;
+        pthread_cond_signal(&shard->work_cond);
+        pthread_mutex_unlock(&shard->mutex);
+        pthread_join(shard->thread, NULL);
+        shard->thread_running = 0;
+        close(shard->fd);
+        shard->fd = -1;
+        free(shard->pending);
+        shard->pending = NULL;
+        shard->pending_len = shard->pending_cap = 0;
+    }
+}
+
+int open_ballot_ledger() {
+    ensure_ledger_shards();
+    #ifdef _WIN32
+        CreateDirectory(LEDGER_DIR, NULL);
+    #else
+        mkdir(LEDGER_DIR, 0755);
+    #endif
+    for (int s = 0; s < ledger_shard_count; s++) {
+        if (!start_ledger_shard(s)) {
+            close_ballot_ledger();
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Seals the current epoch and starts an empty one, clearing the in-memory
+// tallies and voted set under the same locks so no ballot straddles the
+// reset. The sealed segments stay where they are as the archive; only a
+// legacy ballots.log is moved aside, to `legacy_archive_filename`.
+int archive_ballot_ledger(const char* legacy_archive_filename) {
+    ensure_ledger_shards();
+    pthread_mutex_lock(&checkpoint_mutex);
+    for (;;) {
+        // No new ballot can be claimed while voters_lock is held for writing
+        pthread_rwlock_wrlock(&voters_lock);
+        lock_ledger_shards();
+        int idle = 1;
+        for (int s = 0; s < ledger_shard_count; s++) {
+            if (ledger_shards[s].pending_len > 0 || ledger_shards[s].writer_busy) idle = 0;
+        }
+        if (idle) break;
+        // Let the writers drain first; a failed batch needs voters_lock to release its claims
+        unlock_ledger_shards();
+        pthread_rwlock_unlock(&voters_lock);
+        for (int s = 0; s < ledger_shard_count; s++) {
+            LedgerShard *shard = &ledger_shards[s];
+            pthread_mutex_lock(&shard->mutex);
+            while (shard->pending_len > 0 || shard->writer_busy) {
+                pthread_cond_wait(&shard->done_cond, &shard->mutex);
+            }
+            pthread_mutex_unlock(&shard->mutex);
+        }
+    }
+
+    int ok = 1;
+    struct stat st;
+    if (stat(BALLOTS_FILE, &st) == 0 && st.st_size > 0 && rename(BALLOTS_FILE, legacy_archive_filename) != 0) {
+        perror("Failed to archive legacy ballots.log");
+        ok = 0;
+    }
+    if (ok && !save_ledger_epoch(ledger_epoch + 1)) {
+        perror("Failed to seal ballot ledger");
+        ok = 0;
+    }
+    if (ok) {
+        ledger_epoch++;
+        for (int s = 0; s < LEDGER_MAX_SHARDS; s++) {
+            LedgerShard *shard = &ledger_shards[s];
+            memset(&shard->end, 0, sizeof(shard->end));
+            if (!shard->thread_running) continue;
+            close(shard->fd);
+            shard->fd = open_segment_fd(s, 0);
+            if (shard->fd == -1) {
+                perror("Failed to create new ballot ledger segment");
+                ok = 0;
+            }
+        }
+        clear_voted_set();
+        clear_vote_counts();
+        // The snapshot describes the sealed epoch, not the new one
+        if (remove(CHECKPOINT_FILE) != 0 && errno != ENOENT) {
+            perror("Failed to remove checkpoint");
+        }
+    }
+    unlock_ledger_shards();
+    pthread_rwlock_unlock(&voters_lock);
+    pthread_mutex_unlock(&checkpoint_mutex);
+    return ok;
+}
+
+// --- Checkpoints ---
+// checkpoint.bin snapshots the tallies and the voted bitmap together with
+// each ledger shard's position at that moment, so a restart loads it and
+// replays only the ballots written since. It also records enough of the files
+// it was derived from (hashes of the whole of each current segment and of
+// voters.txt up to the snapshot, the legacy file sizes, the mapped registry)
+// to notice when they no longer match, in which case startup falls back to a
+// full replay.
+#define CHECKPOINT_MAGIC "VOTECKP3"
+#define DEFAULT_CHECKPOINT_INTERVAL_S 30
+
+typedef struct CheckpointHeader {
+    char magic[8];
+    uint32_t ledger_epoch;
+    uint32_t ledger_shards;      // Positions at the start of the payload
+    uint64_t voters_source_size; // voters.txt bytes the bitmap indices refer to
+    uint64_t voters_hash;
+    uint64_t legacy_votes_size;  // votes.txt and voted.txt are folded in too
+    uint64_t legacy_voted_size;
+    uint64_t legacy_ballots_size;
+    uint32_t mapped_voters;      // Indices shift if voters.bin is rebuilt
+    uint32_t num_voters;         // Bits in the bitmap that follows the tallies
+    uint32_t num_tallies;
+    uint32_t reserved;
+    uint64_t payload_hash;
+} CheckpointHeader;
+
+typedef struct CheckpointTally {
+    int32_t candidate_id;
+    int32_t votes;
+} CheckpointTally;
+
+long checkpoint_interval_s = DEFAULT_CHECKPOINT_INTERVAL_S;
+
+static pthread_t checkpoint_thread;
+static int checkpoint_thread_running = 0;
+static int checkpoint_stopping = 0;
+static pthread_cond_t checkpoint_stop_cond = PTHREAD_COND_INITIALIZER;
+static unsigned long long last_checkpoint_batches = 0;
+
+// Size of a file, or 0 if it does not exist.
+static uint64_t file_size_or_zero(const char *filename) {
+    struct stat st;
+    return (stat(filename, &st) == 0) ? (uint64_t)st.st_size : 0;
+}
+
+// A file's prefix hash as of the last checkpoint. The files it is kept for
+// only grow while the server runs, so the next checkpoint hashes just the
+// bytes added since instead of the whole file again.
+typedef struct PrefixHash {
+    char path[64];
+    uint64_t size;
+    uint64_t hash;
+} PrefixHash;
+
+// Seeded while startup checks the last checkpoint, then guarded by checkpoint_mutex
+static PrefixHash voters_prefix_hash;
+static PrefixHash segment_prefix_hashes[LEDGER_MAX_SHARDS];
+
+// Hashes a file's first `end` bytes, resuming from `cache` when it holds an
+// earlier prefix of the same file, and leaves the result in `cache`.
+static int hash_named_file_prefix(const char *filename, uint64_t end, PrefixHash *cache, uint64_t *hash_out) {
+    uint64_t start = 0, hash = HASH_BYTES_INIT;
+    if (strcmp(cache->path, filename) == 0 && cache->size <= end) {
+        start = cache->size;
+        hash = cache->hash;
+    }
+    if (start < end) {
+        FILE *file = fopen(filename, "rb");
+        if (file == NULL) return 0;
+        int ok = hash_file_range(file, start, end, &hash);
+        fclose(file);
+        if (!ok) return 0;
+    }
+    snprintf(cache->path, sizeof(cache->path), "%s", filename);
+    cache->size = end;
+    cache->hash = hash;
+    *hash_out = hash;
+    return 1;
+}
+
+
+// Writes checkpoint.bin for the current committed state. Returns 1 on
+// success, or when nothing has been committed since the last one.
+int write_checkpoint(int force) {
+    ensure_ledger_shards();
+    pthread_mutex_lock(&checkpoint_mutex);
+    pthread_rwlock_rdlock(&voters_lock);
+    lock_ledger_shards();
+    unsigned long long batches = __atomic_load_n(&ledger_batches_committed, __ATOMIC_RELAXED);
+    if (!force && batches == last_checkpoint_batches) {
+        unlock_ledger_shards();
+        pthread_rwlock_unlock(&voters_lock);
+        pthread_mutex_unlock(&checkpoint_mutex);
+        return 1;
+    }
+
+    // With every shard locked each set bit is a committed, queued or
+    // in-flight ballot, and the tallies match the shard positions exactly
+    CheckpointHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.ledger_epoch = ledger_epoch;
+    header.ledger_shards = LEDGER_MAX_SHARDS;
+    header.voters_source_size = file_size_or_zero(VOTERS_FILE);
+    header.mapped_voters = (uint32_t)num_mapped_voters;
+    header.num_voters = (uint32_t)num_registered_voters;
+    size_t bitmap_len = ((size_t)num_registered_voters + 7) / 8;
+
+    pthread_rwlock_rdlock(&candidates_lock);
+    header.num_tallies = (uint32_t)num_candidates;
+    size_t positions_len = LEDGER_MAX_SHARDS * sizeof(LedgerPosition);
+    size_t payload_len = positions_len + (size_t)num_candidates * sizeof(CheckpointTally) + bitmap_len;
+    unsigned char *payload = malloc(payload_len);
+    if (payload != NULL) {
+        LedgerPosition *positions = (LedgerPosition *)payload;
+        for (int s = 0; s < LEDGER_MAX_SHARDS; s++) {
+            positions[s] = ledger_shards[s].end;
+        }
+        CheckpointTally *tallies = (CheckpointTally *)(payload + positions_len);
+        for (int i = 0; i < num_candidates; i++) {
+            tallies[i].candidate_id = candidates[i].id;
+            tallies[i].votes = candidates[i].votes;
+        }
+    }
+    pthread_rwlock_unlock(&candidates_lock);
+
+    if (payload != NULL) {
+        unsigned char *bitmap = payload + positions_len + (size_t)header.num_tallies * sizeof(CheckpointTally);
+        if (bitmap_len > 0) memcpy(bitmap, voted_bitmap, bitmap_len);
+        for (int s = 0; s < LEDGER_MAX_SHARDS; s++) {
+            struct ballot_waiter *queues[2] = { ledger_shards[s].inflight_waiters, ledger_shards[s].pending_waiters };
+            for (int q = 0; q < 2; q++) {
+                for (struct ballot_waiter *w = queues[q]; w != NULL; w = w->next) {
+                    if (w->voter_idx != -1) bitmap[w->voter_idx >> 3] &= (unsigned char)~(1u << (w->voter_idx & 7));
+                }
+            }
+        }
+    }
+    unlock_ledger_shards();
+    pthread_rwlock_unlock(&voters_lock);
+    if (payload == NULL) {
+        pthread_mutex_unlock(&checkpoint_mutex);
+        return 0;
+    }
+
+    // The files only grow while the server runs, so the prefixes hashed here
+    // are the ones the snapshot was taken against
+    header.legacy_votes_size = file_size_or_zero(VOTES_FILE);
+    header.legacy_voted_size = file_size_or_zero(VOTED_FILE);
+    header.legacy_ballots_size = file_size_or_zero(BALLOTS_FILE);
+    int ok = hash_named_file_prefix(VOTERS_FILE, header.voters_source_size, &voters_prefix_hash, &header.voters_hash);
+    LedgerPosition *positions = (LedgerPosition *)payload;
+    for (int s = 0; ok && s < LEDGER_MAX_SHARDS; s++) {
+        char path[64];
+        ledger_segment_path(path, sizeof(path), header.ledger_epoch, s, positions[s].segment_seq);
+        ok = hash_named_file_prefix(path, positions[s].offset, &segment_prefix_hashes[s], &positions[s].hash);
+    }
+    header.payload_hash = hash_bytes((const char *)payload, payload_len);
+
+    char tmp_name[64];
+    snprintf(tmp_name, sizeof(tmp_name), "%s.tmp", CHECKPOINT_FILE);
+    FILE *out = ok ? fopen(tmp_name, "wb") : NULL;
+    if (out != NULL) {
+        ok = fwrite(&header, sizeof(header), 1, out) == 1
+          && fwrite(payload, 1, payload_len, out) == payload_len
+          && fflush(out) == 0
+          && fdatasync(fileno(out)) == 0;
+        ok = (fclose(out) == 0) && ok;
+        ok = ok && rename(tmp_name, CHECKPOINT_FILE) == 0;
+        if (!ok) remove(tmp_name);
+    } else {
+        ok = 0;
+    }
+    free(payload);
+    if (ok) {
+        last_checkpoint_batches = batches;
+    } else {
+        perror("Failed to write checkpoint");
+    }
+    pthread_mutex_unlock(&checkpoint_mutex);
+    return ok;
+}
+
+// Applies checkpoint.bin to the freshly loaded registry and candidates and
+// fills `resume_from` with each shard's position to replay from. Returns 0
+// when there is no usable checkpoint and the vote files must be replayed in full.
+int load_checkpoint(LedgerPosition resume_from[LEDGER_MAX_SHARDS]) {
+    FILE *file = fopen(CHECKPOINT_FILE, "rb");
+    if (file == NULL) return 0;
+
+    CheckpointHeader header;
+    unsigned char *payload = NULL;
+    size_t payload_len = 0;
+    const char *problem = NULL;
+    uint64_t file_hash = 0;
+    size_t positions_len = LEDGER_MAX_SHARDS * sizeof(LedgerPosition);
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0
+        || header.ledger_shards != LEDGER_MAX_SHARDS) {
+        problem = "not a checkpoint";
+    } else {
+        payload_len = positions_len + (size_t)header.num_tallies * sizeof(CheckpointTally) + ((size_t)header.num_voters + 7) / 8;
+        payload = malloc(payload_len);
+        if (payload == NULL || fread(payload, 1, payload_len, file) != payload_len
+            || hash_bytes((const char *)payload, payload_len) != header.payload_hash) {
+            problem = "corrupt snapshot";
+        }
+    }
+    fclose(file);
+
+    const LedgerPosition *positions = (const LedgerPosition *)payload;
+    if (problem == NULL && header.ledger_epoch != load_ledger_epoch()) {
+        problem = "the ballot ledger has been archived since";
+    }
+    for (int s = 0; problem == NULL && s < LEDGER_MAX_SHARDS; s++) {
+        char path[64];
+        ledger_segment_path(path, sizeof(path), header.ledger_epoch, s, positions[s].segment_seq);
+        if (file_size_or_zero(path) < positions[s].offset
+            || !hash_named_file_prefix(path, positions[s].offset, &segment_prefix_hashes[s], &file_hash) || file_hash != positions[s].hash) {
+            problem = "a ballot ledger segment has changed";
+        }
+    }
+
+    pthread_rwlock_wrlock(&voters_lock);
+    if (problem == NULL) {
+        if (file_size_or_zero(VOTERS_FILE) < header.voters_source_size
+                   || !hash_named_file_prefix(VOTERS_FILE, header.voters_source_size, &voters_prefix_hash, &file_hash) || file_hash != header.voters_hash
+                   || header.mapped_voters != (uint32_t)num_mapped_voters || header.num_voters > (uint32_t)num_registered_voters) {
+            problem = "the voter registry has changed";
+        } else if (file_size_or_zero(VOTES_FILE) != header.legacy_votes_size || file_size_or_zero(VOTED_FILE) != header.legacy_voted_size
+                   || file_size_or_zero(BALLOTS_FILE) != header.legacy_ballots_size) {
+            problem = "votes.txt, voted.txt or ballots.log has changed";
+        }
+    }
+    if (problem != NULL) {
+        pthread_rwlock_unlock(&voters_lock);
+        fprintf(stderr, "Ignoring %s (%s); replaying the vote files in full.\n", CHECKPOINT_FILE, problem);
+        free(payload);
+        return 0;
+    }
+
+    clear_voted_set();
+    const unsigned char *bitmap = payload + positions_len + (size_t)header.num_tallies * sizeof(CheckpointTally);
+    size_t bitmap_len = ((size_t)header.num_voters + 7) / 8;
+    int voted = 0;
+    for (size_t i = 0; i < bitmap_len; i++) {
+        unsigned char byte = bitmap[i];
+        if (i == bitmap_len - 1 && (header.num_voters & 7) != 0) {
+            byte &= (unsigned char)((1u << (header.num_voters & 7)) - 1);
+        }
+        voted_bitmap[i] = byte;
+        voted += __builtin_popcount(byte);
+    }
+    __atomic_store_n(&num_voters_voted, voted, __ATOMIC_RELAXED);
+    pthread_rwlock_unlock(&voters_lock);
+
+    const CheckpointTally *tallies = (const CheckpointTally *)(payload + positions_len);
+    pthread_rwlock_wrlock(&candidates_lock);
+    for (int i = 0; i < num_candidates; i++) {
+        candidates[i].votes = 0;
+    }
+    for (uint32_t i = 0; i < header.num_tallies; i++) {
+        int slot = find_candidate_slot(tallies[i].candidate_id);
+        if (slot != -1) candidates[slot].votes = tallies[i].votes;
+    }
+    pthread_rwlock_unlock(&candidates_lock);
+    notify_results_changed();
+    memcpy(resume_from, positions, positions_len);
+    free(payload);
+
+    printf("--- Checkpoint Loaded: %d voters have voted ---\n", voted);
+    return 1;
+}
+
+static void *checkpoint_main(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&checkpoint_mutex);
+    while (!checkpoint_stopping) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += checkpoint_interval_s;
+        if (pthread_cond_timedwait(&checkpoint_stop_cond, &checkpoint_mutex, &deadline) == ETIMEDOUT && !checkpoint_stopping) {
+            pthread_mutex_unlock(&checkpoint_mutex);
+            write_checkpoint(0);
+            pthread_mutex_lock(&checkpoint_mutex);
+        }
+    }
+    pthread_mutex_unlock(&checkpoint_mutex);
+    return NULL;
+}
+
+int start_checkpoints() {
+    if (checkpoint_interval_s <= 0) return 1;
+    checkpoint_stopping = 0;
+    if (pthread_create(&checkpoint_thread, NULL, checkpoint_main, NULL) != 0) {
+        perror("Failed to start checkpoint thread");
+        return 0;
+    }
+    checkpoint_thread_running = 1;
+    return 1;
+}
+
+// Stops the periodic thread and writes a last checkpoint, so a clean
+// shutdown restarts without any ledger replay. Run after close_ballot_ledger.
+void stop_checkpoints() {
+    if (checkpoint_thread_running) {
+        pthread_mutex_lock(&checkpoint_mutex);
+        checkpoint_stopping = 1;
+        pthread_cond_signal(&checkpoint_stop_cond);
+        pthread_mutex_unlock(&checkpoint_mutex);
+        pthread_join(checkpoint_thread, NULL);
+        checkpoint_thread_running = 0;
+    }
+    if (checkpoint_interval_s > 0) write_checkpoint(0);
+}
+
+// MODIFIED: Function signature and fprintf now include party
+int add_new_candidate(const char* id, const char* name, const char* party, const char* image_url) {
+    if (id[0] == '\0' || name[0] == '\0' || party[0] == '\0' || image_url[0] == '\0') {
+        return 0;
+    }
+    
+    FILE* file = fopen(CANDIDATES_FILE, "a");
+    if (!file) {
+        perror("Failed to open candidates file for appending");
+        return 0;
+    }
+    lock_file(file, LOCK_EXCLUSIVE, CANDIDATES_FILE);
+    
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    if (size > 0) {
+        fprintf(file, "\n");
+    }
+    
+    int id_num = atoi(id);
+    fprintf(file, "%d,%s,%s,%s", id_num, name, party, image_url);
+    
+    unlock_file(file);
+    fclose(file);
+    invalidate_page_cache();
+    return 1;
+}
+
+int add_new_voter(const char* aadhar, const char* name) {
+    if (aadhar[0] == '\0' || name[0] == '\0') {
+        return 0;
+    }
+
+    FILE* file = fopen(VOTERS_FILE, "a");
+    if (!file) {
+        perror("Failed to open voters file for appending");
+        return 0;
+    }
+    lock_file(file, LOCK_EXCLUSIVE, VOTERS_FILE);
+    
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    if (size > 0) {
+        fprintf(file, "\n");
+    }
+    
+    fprintf(file, "%s,%s", aadhar, name);
+    
+    unlock_file(file);
+    fclose(file);
+
+    pthread_rwlock_wrlock(&voters_lock);
+    register_voter_in_memory(aadhar, name);
+    pthread_rwlock_unlock(&voters_lock);
+    notify_results_changed();
+    return 1;
+}
+
+// --- Election State & Name ---
+void load_election_state() {
+    FILE* file = fopen(ELECTION_STATUS_FILE, "r");
+    if (!file) {
+        strcpy(ELECTION_STATE, "PREP");
+        FILE* wfile = fopen(ELECTION_STATUS_FILE, "w");
+        if (wfile) {
+            fprintf(wfile, "PREP\n");
+            fclose(wfile);
+        }
+    } else {
+        if (fscanf(file, "%19s", ELECTION_STATE) != 1) {
+            strcpy(ELECTION_STATE, "PREP");
+        }
+        fclose(file);
+    }
+    printf("--- Election State Loaded: %s ---\n", ELECTION_STATE);
+}
+
+void save_election_state(const char* state) {
+    FILE* file = fopen(ELECTION_STATUS_FILE, "w");
+    if (file) {
+        fprintf(file, "%s\n", state);
+        fclose(file);
+        pthread_rwlock_wrlock(&election_lock);
+        strcpy(ELECTION_STATE, state);
+        pthread_rwlock_unlock(&election_lock);
+        invalidate_page_cache();
+        printf("--- Election State Saved: %s ---\n", state);
+    } else {
+        perror("CRITICAL: Failed to save election state!");
+    }
+}
+
+// Request threads read the election state and name through these copies.
+void copy_election_state(char *out) {
+    pthread_rwlock_rdlock(&election_lock);
+    strcpy(out, ELECTION_STATE);
+    pthread_rwlock_unlock(&election_lock);
+}
+
+void copy_election_name(char *out) {
+    pthread_rwlock_rdlock(&election_lock);
+    strcpy(out, ELECTION_NAME);
+    pthread_rwlock_unlock(&election_lock);
+}
+
+void load_election_name() {
+    FILE* file = fopen(ELECTION_NAME_FILE, "r");
+    if (!file) {
+        strcpy(ELECTION_NAME, DEFAULT_ELECTION_NAME);
+        FILE* wfile = fopen(ELECTION_NAME_FILE, "w");
+        if (wfile) {
+            fprintf(wfile, "%s\n", DEFAULT_ELECTION_NAME);
+            fclose(wfile);
+        }
+    } else {
+        if (fgets(ELECTION_NAME, sizeof(ELECTION_NAME), file) == NULL) {
+             strcpy(ELECTION_NAME, DEFAULT_ELECTION_NAME);
+        }
+        ELECTION_NAME[strcspn(ELECTION_NAME, "\r\n")] = 0;
+        fclose(file);
+    }
+    printf("--- Election Name Loaded: %s ---\n", ELECTION_NAME);
+}
+
+void save_election_name(const char* name) {
+    FILE* file = fopen(ELECTION_NAME_FILE, "w");
+    if (file) {
+        fprintf(file, "%s\n", name);
+        fclose(file);
+        pthread_rwlock_wrlock(&election_lock);
+        strncpy(ELECTION_NAME, name, sizeof(ELECTION_NAME) - 1);
+        ELECTION_NAME[sizeof(ELECTION_NAME) - 1] = '\0';
+        pthread_rwlock_unlock(&election_lock);
+        invalidate_page_cache();
+        printf("--- Election Name Saved: %s ---\n", name);
+    } else {
+        perror("CRITICAL: Failed to save election name!");
+    }
+}
+
+
+int archive_votes_file() {
+    char archive_filename[100];
+    time_t now = time(NULL);
+    struct tm tm_buf;
+    struct tm *t = localtime_r(&now, &tm_buf);
+
+    strftime(archive_filename, sizeof(archive_filename), "ballots_archive_%Y%m%d_%H%M%S.log", t);
+    if (!archive_ballot_ledger(archive_filename)) {
+        return 0;
+    }
+    invalidate_page_cache();
+
+    FILE* voted_file = fopen(VOTED_FILE, "w");
+    if (!voted_file) {
+        perror("Failed to clear voted.txt");
+        return 0;
+    }
+    fclose(voted_file);
+
+    FILE* votes_file = fopen(VOTES_FILE, "r");
+    if (!votes_file) {
+        return 1;
+    }
+    fseek(votes_file, 0, SEEK_END);
+    if (ftell(votes_file) == 0) {
+        fclose(votes_file);
+        return 1;
+    }
+    fclose(votes_file); 
+
+    strftime(archive_filename, sizeof(archive_filename), "votes_archive_%Y%m%d_%H%M%S.txt", t);
+
+    if (rename(VOTES_FILE, archive_filename) != 0) {
+        perror("Failed to archive votes.txt");
+        return 0;
+    }
+
+    FILE* new_votes_file = fopen(VOTES_FILE, "w");
+    if (!new_votes_file) {
+        perror("Failed to create new votes.txt");
+        return 0;
+    }
+    fclose(new_votes_file);
+
+    return 1;
+}
+
+// --- Data Analytics Helper Functions ---
+int count_lines_in_file(const char *filename) {
+    FILE *file = fopen(filename, "r");
+    if (!file) return 0;
+    lock_file(file, LOCK_SHARED, filename);
+    
+    int lines = 0;
+    int ch;
+    long char_count = 0;
+    int last_char = -1;
+
+    while ((ch = fgetc(file)) != EOF) {
+        char_count++;
+        if (ch == '\n') {
+            lines++;
+        }
+        last_char = ch;
+    }
+
+    if (char_count > 0 && last_char != '\n' && lines == 0) {
+         lines = 1; 
+    } else if (char_count > 0 && last_char != '\n') {
+         lines++;
+    }
+
+    unlock_file(file);
+    fclose(file);
+    
+    return lines;
+}
+
+// The registry already holds every voter, so dashboards need not rescan voters.txt
+int get_registered_voter_count() {
+    pthread_rwlock_rdlock(&voters_lock);
+    int count = num_registered_voters;
+    pthread_rwlock_unlock(&voters_lock);
+    return count;
+}
+
+int get_cast_vote_count() {
+    return __atomic_load_n(&num_voters_voted, __ATOMIC_RELAXED);
+}
+
+
+// --- Response Builder ---
+// Growable per-request output buffer. Capacity doubles, so appends are
+// amortized O(1), and the finished buffer is handed to MHD as-is.
+#define PAGE_INITIAL_CAPACITY 16384
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+    int failed; // Set once an allocation fails; later appends become no-ops
+} PageBuffer;
+
+static int page_reserve(PageBuffer *page, size_t extra) {
+    if (page->failed) return 0;
+    if (page->len + extra + 1 <= page->cap) return 1;
+    size_t new_cap = (page->cap == 0) ? PAGE_INITIAL_CAPACITY : page->cap;
+    while (page->len + extra + 1 > new_cap) new_cap *= 2;
+    char *new_data = realloc(page->data, new_cap);
+    if (new_data == NULL) {
+        page->failed = 1;
+        return 0;
+    }
+    page->data = new_data;
+    page->cap = new_cap;
+    return 1;
+}
+
+void page_append_len(PageBuffer *page, const char *text, size_t len) {
+    if (!page_reserve(page, len)) return;
+    memcpy(page->data + page->len, text, len);
+    page->len += len;
+    page->data[page->len] = '\0';
+}
+
+void page_append(PageBuffer *page, const char *text) {
+    page_append_len(page, text, strlen(text));
+}
+
+void page_appendf(PageBuffer *page, const char *fmt, ...) {
+    if (!page_reserve(page, 256)) return;
+    va_list args;
+    va_start(args, fmt);
+    int needed = vsnprintf(page->data + page->len, page->cap - page->len, fmt, args);
+    va_end(args);
+    if (needed < 0) {
+        page->failed = 1;
+        return;
+    }
+    if ((size_t)needed >= page->cap - page->len) {
+        if (!page_reserve(page, (size_t)needed)) return;
+        va_start(args, fmt);
+        vsnprintf(page->data + page->len, page->cap - page->len, fmt, args);
+        va_end(args);
+    }
+    page->len += (size_t)needed;
+}
+
+// Appends text with the characters that are special in HTML escaped.
+void page_append_html(PageBuffer *page, const char *text) {
+    const char *run = text;
+    for (const char *c = text; ; c++) {
+        const char *entity = NULL;
+        switch (*c) {
+            case '&': entity = "&amp;"; break;
+            case '<': entity = "&lt;"; break;
+            case '>': entity = "&gt;"; break;
+            case '"': entity = "&quot;"; break;
+            case '\'': entity = "&#39;"; break;
+            case '\0': page_append_len(page, run, (size_t)(c - run)); return;
+        }
+        if (entity != NULL) {
+            page_append_len(page, run, (size_t)(c - run));
+            page_append(page, entity);
+            run = c + 1;
+        }
+    }
+}
+
+// Appends text as the inside of a JSON string literal.
+void page_append_json(PageBuffer *page, const char *text) {
+    const char *run = text;
+    for (const char *c = text; *c; c++) {
+        unsigned char ch = (unsigned char)*c;
+        if (ch != '"' && ch != '\\' && ch >= 0x20) continue;
+        page_append_len(page, run, (size_t)(c - run));
+        if (ch == '"' || ch == '\\') {
+            char escaped[3] = { '\\', (char)ch, '\0' };
+            page_append(page, escaped);
+        } else {
+            page_appendf(page, "\\u%04x", ch);
+        }
+        run = c + 1;
+    }
+    page_append(page, run);
+}
+
+void page_free(PageBuffer *page) {
+    free(page->data);
+    page->data = NULL;
+    page->len = page->cap = 0;
+}
+
+// Copies the candidate list under the read lock so a page can be rendered
+// without blocking the ballot writer. Caller frees the result.
+Candidate *snapshot_candidates(int *count) {
+    pthread_rwlock_rdlock(&candidates_lock);
+    Candidate *copy = NULL;
+    *count = 0;
+    if (num_candidates > 0) {
+        copy = malloc((size_t)num_candidates * sizeof(Candidate));
+        if (copy != NULL) {
+            memcpy(copy, candidates, (size_t)num_candidates * sizeof(Candidate));
+            *count = num_candidates;
+        }
+    }
+    pthread_rwlock_unlock(&candidates_lock);
+    return copy;
+}
+
+
+// --- Bulk Voter Import ---
+// POST /import_voters streams an "Aadhar,Name" CSV through iterate_post.
+// Rows are validated and checked against the registry as they arrive, then
+// appended to voters.txt and registered in memory a batch at a time, so a
+// 2M-row roll costs a few hundred syncs instead of 2M dashboard renders.
+#define VOTER_IMPORT_BATCH_ROWS 16384
+#define VOTER_IMPORT_LINE_MAX 256
+#define VOTER_IMPORT_REJECT_SAMPLE 10
+#define AADHAR_DIGITS 12
+
+typedef struct VoterImport {
+    char line[VOTER_IMPORT_LINE_MAX];
+    size_t line_len;
+    int line_too_long;
+    long line_number;
+
+    PageBuffer batch;                 // voters.txt lines not yet written
+    Voter *pending;                   // Same rows, registered once they are on disk
+    int num_pending;
+    int *pending_slots;               // Hash set over pending, catches repeats within the file
+
+    long rows;
+    long imported;
+    long duplicates;
+    long rejected;
+    int write_failed;
+    int register_failed;              // Rows reached voters.txt but not memory; they load on restart
+    long rejected_lines[VOTER_IMPORT_REJECT_SAMPLE];
+    const char *rejected_reasons[VOTER_IMPORT_REJECT_SAMPLE];
+} VoterImport;
+
+VoterImport *voter_import_begin() {
+    VoterImport *imp = calloc(1, sizeof(VoterImport));
+    if (imp == NULL) return NULL;
+    imp->pending = malloc(VOTER_IMPORT_BATCH_ROWS * sizeof(Voter));
+    imp->pending_slots = malloc(2 * VOTER_IMPORT_BATCH_ROWS * sizeof(int));
+    if (imp->pending == NULL || imp->pending_slots == NULL) {
+        free(imp->pending);
+        free(imp->pending_slots);
+        free(imp);
+        return NULL;
+    }
+    for (int i = 0; i < 2 * VOTER_IMPORT_BATCH_ROWS; i++) imp->pending_slots[i] = VOTER_SLOT_EMPTY;
+    return imp;
+}
+
+void voter_import_free(VoterImport *imp) {
+    if (imp == NULL) return;
+    page_free(&imp->batch);
+    free(imp->pending);
+    free(imp->pending_slots);
+    free(imp);
+}
+
+static void reject_import_row(VoterImport *imp, const char *reason) {
+    if (imp->rejected < VOTER_IMPORT_REJECT_SAMPLE) {
+        imp->rejected_lines[imp->rejected] = imp->line_number;
+        imp->rejected_reasons[imp->rejected] = reason;
+    }
+    imp->rejected++;
+}
+
+// Inserts into the pending set; returns 0 if the Aadhar is already pending.
+static int claim_pending_aadhar(VoterImport *imp, const char *aadhar) {
+    size_t mask = 2 * VOTER_IMPORT_BATCH_ROWS - 1;
+    size_t slot = hash_aadhar(aadhar) & mask;
+    while (imp->pending_slots[slot] != VOTER_SLOT_EMPTY) {
+        if (strcmp(imp->pending[imp->pending_slots[slot]].aadhar, aadhar) == 0) return 0;
+        slot = (slot + 1) & mask;
+    }
+    imp->pending_slots[slot] = imp->num_pending;
+    return 1;
+}
+
+static char *trim_field(char *s) {
+    while (*s == ' ' || *s == '\t') s++;
+    char *end = s + strlen(s);
+    while (end > s && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r')) end--;
+    *end = '\0';
+    return s;
+}
+
+// Caller holds voters_lock for reading.
+static void process_import_line(VoterImport *imp, char *line) {
+    char *comma = strchr(line, ',');
+    char *aadhar = line;
+    char *name = "";
+    if (comma != NULL) {
+        *comma = '\0';
+        name = trim_field(comma + 1);
+    }
+    aadhar = trim_field(aadhar);
+    if (aadhar[0] == '\0' && name[0] == '\0') return; // Blank line
+
+    // Allow a header row such as "Aadhar,Name"
+    if (imp->line_number == 1 && strncasecmp(aadhar, "aadhar", 6) == 0) return;
+
+    imp->rows++;
+    size_t digits = strspn(aadhar, "0123456789");
+    if (digits != AADHAR_DIGITS || aadhar[digits] != '\0') {
+        reject_import_row(imp, "Aadhar must be 12 digits");
+        return;
+    }
+    if (name[0] == '\0') {
+        reject_import_row(imp, "missing name");
+        return;
+    }
+    if (strlen(name) >= sizeof(((Voter *)0)->name)) {
+        reject_import_row(imp, "name longer than 99 characters");
+        return;
+    }
+    for (const char *c = name; *c; c++) {
+        if ((unsigned char)*c < 0x20 || strchr("<>&\"'", *c) != NULL) {
+            reject_import_row(imp, "name contains unsupported characters");
+            return;
+        }
+    }
+    if (find_voter(aadhar) != -1 || !claim_pending_aadhar(imp, aadhar)) {
+        imp->duplicates++;
+        return;
+    }
+
+    Voter *v = &imp->pending[imp->num_pending++];
+    strcpy(v->aadhar, aadhar);
+    strcpy(v->name, name);
+    page_appendf(&imp->batch, "%s%s,%s", imp->batch.len > 0 ? "\n" : "", aadhar, name);
+}
+
+// Appends the pending rows to voters.txt, syncs, then registers them.
+int voter_import_flush(VoterImport *imp) {
+    if (imp->num_pending == 0) return !imp->write_failed && !imp->register_failed;
+    int ok = !imp->write_failed && !imp->register_failed && !imp->batch.failed;
+    if (ok) {
+        FILE *file = fopen(VOTERS_FILE, "a+");
+        if (file == NULL) {
+            perror("Failed to open voters file for import");
+            ok = 0;
+        } else {
+            lock_file(file, LOCK_EXCLUSIVE, VOTERS_FILE);
+            // Keep the file's one-voter-per-line layout whether or not it ends in a newline
+            int needs_newline = 0;
+            if (fseek(file, -1, SEEK_END) == 0) needs_newline = fgetc(file) != '\n';
+            fseek(file, 0, SEEK_END);
+            if (needs_newline) fputc('\n', file);
+            ok = fwrite(imp->batch.data, 1, imp->batch.len, file) == imp->batch.len;
+            ok = fflush(file) == 0 && ok;
+            ok = ok && fdatasync(fileno(file)) == 0;
+            if (!ok) perror("Failed to write imported voters");
+            unlock_file(file);
+            fclose(file);
+        }
+    }
+
+    if (ok) {
+        int registered = 0;
+        pthread_rwlock_wrlock(&voters_lock);
+        while (registered < imp->num_pending &&
+               register_voter_in_memory(imp->pending[registered].aadhar, imp->pending[registered].name) != -1) {
+            registered++;
+        }
+        pthread_rwlock_unlock(&voters_lock);
+        imp->imported += registered;
+        if (registered < imp->num_pending) {
+            imp->register_failed = 1;
+            ok = 0;
+        }
+        if (registered > 0) notify_results_changed();
+    } else if (!imp->register_failed) {
+        imp->write_failed = 1;
+    }
+
+    imp->batch.len = 0;
+    imp->num_pending = 0;
+    for (int i = 0; i < 2 * VOTER_IMPORT_BATCH_ROWS; i++) imp->pending_slots[i] = VOTER_SLOT_EMPTY;
+    return ok;
+}
+
+// Consumes one chunk of the upload. Lines may span chunks.
+int voter_import_feed(VoterImport *imp, const char *data, size_t size) {
+    pthread_rwlock_rdlock(&voters_lock);
+    for (size_t i = 0; i < size; i++) {
+        char c = data[i];
+        if (c != '\n') {
+            if (imp->line_len < VOTER_IMPORT_LINE_MAX - 1) {
+                imp->line[imp->line_len++] = c;
+            } else {
+                imp->line_too_long = 1;
+            }
+            continue;
+        }
+        imp->line_number++;
+        imp->line[imp->line_len] = '\0';
+        if (imp->line_too_long) {
+            imp->rows++;
+            reject_import_row(imp, "line too long");
+        } else {
+            process_import_line(imp, imp->line);
+        }
+        imp->line_len = 0;
+        imp->line_too_long = 0;
+
+        if (imp->num_pending == VOTER_IMPORT_BATCH_ROWS) {
+            pthread_rwlock_unlock(&voters_lock);
+            voter_import_flush(imp);
+            pthread_rwlock_rdlock(&voters_lock);
+        }
+    }
+    pthread_rwlock_unlock(&voters_lock);
+    return !imp->write_failed && !imp->register_failed;
+}
+
+// Handles a final line without a trailing newline and writes what is left.
+int voter_import_finish(VoterImport *imp) {
+    if (imp->line_len > 0 || imp->line_too_long) voter_import_feed(imp, "\n", 1);
+    return voter_import_flush(imp);
+}
+
+// Summarises the import for the dashboard's flash message.
+void describe_voter_import(const VoterImport *imp, char *out, size_t out_size) {
+    int n = snprintf(out, out_size, "%s Imported %ld of %ld voter rows; %ld already registered, %ld rejected.",
+                     imp->write_failed ? "Error: Import stopped by a write failure." :
+                     imp->register_failed ? "Error: Import stopped, out of memory; saved rows load on restart." : "Success!",
+                     imp->imported, imp->rows, imp->duplicates, imp->rejected);
+    long shown = imp->rejected < VOTER_IMPORT_REJECT_SAMPLE ? imp->rejected : VOTER_IMPORT_REJECT_SAMPLE;
+    for (long i = 0; i < shown && n > 0 && (size_t)n < out_size; i++) {
+        n += snprintf(out + n, out_size - n, "%s line %ld: %s", i == 0 ? " Rejected:" : ";",
+                      imp->rejected_lines[i], imp->rejected_reasons[i]);
+    }
+    if (imp->rejected > shown && n > 0 && (size_t)n < out_size) {
+        snprintf(out + n, out_size - n, "; and %ld more", imp->rejected - shown);
+    }
+}
+
+
+// --- Photo Upload ---
+// Each candidate photo upload streams into its own unnamed temporary file in
+// images/ (O_TMPFILE, or mkstemp where that is unavailable) through a large
+// write buffer. The first bytes must be a JPEG or PNG signature, whatever
+// the client claims the type is. A finished upload is given a name and
+// renamed over the candidate's photo, so readers and concurrent uploads
+// only ever see complete files.
+#define PHOTO_UPLOAD_BUFFER_BYTES (256 * 1024)
+#define PHOTO_SNIFF_BYTES 8
+
+typedef struct PhotoUpload {
+    int fd;
+    char temp_path[64];  // Empty while the file is anonymous (O_TMPFILE)
+    size_t size;
+    const char *extension; // Set from the signature once PHOTO_SNIFF_BYTES have arrived
+    size_t buffered;
+    char buffer[PHOTO_UPLOAD_BUFFER_BYTES];
+} PhotoUpload;
+
+// Returns the file extension for a JPEG or PNG signature, or NULL.
+static const char *sniff_image_extension(const unsigned char *head, size_t len) {
+    static const unsigned char png_signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    if (len >= 3 && head[0] == 0xFF && head[1] == 0xD8 && head[2] == 0xFF) return ".jpg";
+    if (len >= sizeof(png_signature) && memcmp(head, png_signature, sizeof(png_signature)) == 0) return ".png";
+    return NULL;
+}
+
+static int open_photo_temp(PhotoUpload *up) {
+    up->temp_path[0] = '\0';
+    #ifdef O_TMPFILE
+        up->fd = open(UPLOAD_DIR, O_TMPFILE | O_WRONLY, 0644);
+        if (up->fd != -1) return 1;
+        // Filesystems without O_TMPFILE fall back to a named file
+    #endif
+    #ifdef _WIN32
+        snprintf(up->temp_path, sizeof(up->temp_path), "%s/upload-XXXXXX", UPLOAD_DIR);
+        if (_mktemp_s(up->temp_path, strlen(up->temp_path) + 1) != 0) return 0;
+        up->fd = _open(up->temp_path, _O_WRONLY | _O_CREAT | _O_EXCL | _O_BINARY, _S_IREAD | _S_IWRITE);
+    #else
+        snprintf(up->temp_path, sizeof(up->temp_path), "%s/.upload-XXXXXX", UPLOAD_DIR);
+        up->fd = mkstemp(up->temp_path);
+        if (up->fd != -1) fchmod(up->fd, 0644);
+    #endif
+    if (up->fd == -1) up->temp_path[0] = '\0';
+    return up->fd != -1;
+}
+
+PhotoUpload *photo_upload_begin() {
+    PhotoUpload *up = malloc(sizeof(PhotoUpload));
+    if (up == NULL) return NULL;
+    up->size = 0;
+    up->buffered = 0;
+    up->extension = NULL;
+    if (!open_photo_temp(up)) {
+        perror("Failed to create upload file");
+        free(up);
+        return NULL;
+    }
+    return up;
+}
+
+static int photo_upload_flush(PhotoUpload *up) {
+    if (up->buffered == 0) return 1;
+    if (!write_all(up->fd, up->buffer, up->buffered)) return 0;
+    up->buffered = 0;
+    return 1;
+}
+
+// Appends a chunk. Returns 0, or the error_flag value to report (1 = too
+// large, 2 = not a JPEG/PNG, 3 = write error).
+int photo_upload_feed(PhotoUpload *up, const char *data, size_t size) {
+    if (up->size + size > MAX_UPLOAD_SIZE) return 1;
+    while (size > 0) {
+        size_t n = PHOTO_UPLOAD_BUFFER_BYTES - up->buffered;
+        if (n > size) n = size;
+        memcpy(up->buffer + up->buffered, data, n);
+        up->buffered += n;
+        up->size += n;
+        data += n;
+        size -= n;
+        // The buffer is far larger than the signature, so it is still at the front
+        if (up->extension == NULL && up->size >= PHOTO_SNIFF_BYTES) {
+            up->extension = sniff_image_extension((const unsigned char *)up->buffer, up->size);
+            if (up->extension == NULL) return 2;
+        }
+        if (up->buffered == PHOTO_UPLOAD_BUFFER_BYTES && !photo_upload_flush(up)) return 3;
+    }
+    return 0;
+}
+
+// Writes out the upload and moves it to final_path, replacing any previous
+// photo in a single step. The upload must still be freed afterwards.
+int photo_upload_commit(PhotoUpload *up, const char *final_path) {
+    if (!photo_upload_flush(up) || fdatasync(up->fd) != 0) return 0;
+    #ifdef O_TMPFILE
+        static unsigned int photo_upload_counter = 0;
+        if (up->temp_path[0] == '\0') {
+            // linkat cannot replace an existing file, so link under a fresh name and rename that
+            char fd_path[64];
+            snprintf(fd_path, sizeof(fd_path), "/proc/self/fd/%d", up->fd);
+            int linked = 0;
+            for (int attempt = 0; attempt < 16 && !linked; attempt++) {
+                snprintf(up->temp_path, sizeof(up->temp_path), "%s/.upload-%ld-%u", UPLOAD_DIR, (long)getpid(),
+                         __atomic_add_fetch(&photo_upload_counter, 1, __ATOMIC_RELAXED));
+                linked = linkat(AT_FDCWD, fd_path, AT_FDCWD, up->temp_path, AT_SYMLINK_FOLLOW) == 0;
+                if (!linked && errno != EEXIST) break;
+            }
+            if (!linked) {
+                up->temp_path[0] = '\0';
+                return 0;
+            }
+        }
+    #endif
+    close(up->fd);
+    up->fd = -1;
+    #ifdef _WIN32
+        int moved = MoveFileExA(up->temp_path, final_path, MOVEFILE_REPLACE_EXISTING) != 0;
+    #else
+        int moved = rename(up->temp_path, final_path) == 0;
+    #endif
+    if (moved) up->temp_path[0] = '\0';
+    return moved;
+}
+
+// Closes the upload, deleting whatever was not committed.
+void photo_upload_free(PhotoUpload *up) {
+    if (up == NULL) return;
+    if (up->fd != -1) close(up->fd);
+    if (up->temp_path[0] != '\0') remove(up->temp_path);
+    free(up);
+}
+
+
+// --- Image Cache ---
+// Candidate photos under images/ are opened and hashed once, then served from
+// shared MHD responses over the open file, which MHD sends with sendfile().
+// Pages link them as /images/<file>?v=<content hash>: a request whose v
+// matches is cacheable for a year as immutable, anything else gets a strong
+// ETag and must revalidate. Files are re-stat'ed at most every
+// IMAGE_CACHE_RECHECK_SEC, and uploads drop their entry immediately.
+#define IMAGE_CACHE_MAX_ENTRIES 256
+#define IMAGE_CACHE_RECHECK_SEC 5
+#define IMAGE_NAME_MAX 128
+#define IMAGE_IMMUTABLE_CACHE_CONTROL "public, max-age=31536000, immutable"
+#define IMAGE_REVALIDATE_CACHE_CONTROL "public, no-cache"
+
+typedef struct {
+    char name[IMAGE_NAME_MAX];  // File name inside images/ ("" = free slot)
+    char version[17];           // Content hash in hex, used as ?v= and the ETag
+    char etag[20];
+    char last_modified[40];
+    const char *mime_type;
+    time_t mtime;
+    off_t size;
+    time_t checked_at;
+    // One response per Cache-Control variant, each over its own fd
+    struct MHD_Response *immutable;
+    struct MHD_Response *revalidate;
+    struct MHD_Response *immutable_not_modified;
+    struct MHD_Response *revalidate_not_modified;
+} CachedImage;
+
+static CachedImage image_cache[IMAGE_CACHE_MAX_ENTRIES];
+static int image_cache_next_victim = 0;
+pthread_rwlock_t image_cache_lock = PTHREAD_RWLOCK_INITIALIZER; // Leaf lock
+
+const char *get_mime_type(const char *filename) {
+    static const struct { const char *ext; const char *type; } types[] = {
+        { "jpg", "image/jpeg" }, { "jpeg", "image/jpeg" }, { "png", "image/png" }, { "gif", "image/gif" },
+        { "webp", "image/webp" }, { "svg", "image/svg+xml" }, { "ico", "image/x-icon" },
+        { "css", "text/css" }, { "js", "application/javascript" },
+    };
+    const char *dot = strrchr(filename, '.');
+    if (dot != NULL) {
+        for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+            if (strcasecmp(dot + 1, types[i].ext) == 0) return types[i].type;
+        }
+    }
+    return "application/octet-stream";
+}
+
+// Only plain file names are served: no directories, no dot files.
+static int valid_image_name(const char *name) {
+    size_t len = strlen(name);
+    if (len == 0 || len >= IMAGE_NAME_MAX || name[0] == '.') return 0;
+    for (size_t i = 0; i < len; i++) {
+        char c = name[i];
+        if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '.' || c == '_' || c == '-')) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void release_cached_image(CachedImage *image) {
+    // Connections still sending an old response hold their own reference
+    if (image->immutable) MHD_destroy_response(image->immutable);
+    if (image->revalidate) MHD_destroy_response(image->revalidate);
+    if (image->immutable_not_modified) MHD_destroy_response(image->immutable_not_modified);
+    if (image->revalidate_not_modified) MHD_destroy_response(image->revalidate_not_modified);
+    memset(image, 0, sizeof(*image));
+}
+
+static struct MHD_Response *make_image_response(int fd, const CachedImage *image, const char *cache_control) {
+    struct MHD_Response *response = (fd == -1) ? MHD_create_response_from_buffer(0, NULL, MHD_RESPMEM_PERSISTENT)
+                                               : MHD_create_response_from_fd((uint64_t)image->size, fd);
+    if (response == NULL) {
+        if (fd != -1) close(fd);
+        return NULL;
+    }
+    if (fd != -1) MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_TYPE, image->mime_type);
+    MHD_add_response_header(response, MHD_HTTP_HEADER_ETAG, image->etag);
+    MHD_add_response_header(response, MHD_HTTP_HEADER_LAST_MODIFIED, image->last_modified);
+    MHD_add_response_header(response, MHD_HTTP_HEADER_CACHE_CONTROL, cache_control);
+    MHD_add_response_header(response, "X-Content-Type-Options", "nosniff");
+    return response;
+}
+
+// Opens, hashes and wraps images/<name>. Returns 0 if it is not a readable file.
+static int load_cached_image(CachedImage *image, const char *name) {
+    char path[IMAGE_NAME_MAX + 16];
+    snprintf(path, sizeof(path), "%s/%s", UPLOAD_DIR, name);
+    #ifdef _WIN32
+        int fd = _open(path, _O_RDONLY | _O_BINARY);
+    #else
+        int fd = open(path, O_RDONLY);
+    #endif
+    if (fd == -1) return 0;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return 0;
+    }
+
+    char buffer[16384];
+    unsigned long long hash = HASH_BYTES_INIT;
+    off_t total = 0;
+    ssize_t n;
+    while ((n = read(fd, buffer, sizeof(buffer))) > 0) {
+        hash = hash_bytes_update(hash, buffer, (size_t)n);
+        total += n;
+    }
+    int second_fd = (n == 0 && total == st.st_size) ? dup(fd) : -1;
+    if (second_fd == -1) {
+        close(fd);
+        return 0;
+    }
+
+    memset(image, 0, sizeof(*image));
+    snprintf(image->name, sizeof(image->name), "%s", name);
+    snprintf(image->version, sizeof(image->version), "%016llx", hash);
+    snprintf(image->etag, sizeof(image->etag), "\"%s\"", image->version);
+    struct tm tm_buf;
+    strftime(image->last_modified, sizeof(image->last_modified), "%a, %d %b %Y %H:%M:%S GMT", gmtime_r(&st.st_mtime, &tm_buf));
+    image->mime_type = get_mime_type(name);
+    image->mtime = st.st_mtime;
+    image->size = st.st_size;
+    image->checked_at = time(NULL);
+    image->immutable = make_image_response(fd, image, IMAGE_IMMUTABLE_CACHE_CONTROL);
+    image->revalidate = make_image_response(second_fd, image, IMAGE_REVALIDATE_CACHE_CONTROL);
+    image->immutable_not_modified = make_image_response(-1, image, IMAGE_IMMUTABLE_CACHE_CONTROL);
+    image->revalidate_not_modified = make_image_response(-1, image, IMAGE_REVALIDATE_CACHE_CONTROL);
+    if (!image->immutable || !image->revalidate || !image->immutable_not_modified || !image->revalidate_not_modified) {
+        release_cached_image(image);
+        return 0;
+    }
+    return 1;
+}
+
+static CachedImage *find_cached_image(const char *name) {
+    for (int i = 0; i < IMAGE_CACHE_MAX_ENTRIES; i++) {
+        if (image_cache[i].name[0] != '\0' && strcmp(image_cache[i].name, name) == 0) return &image_cache[i];
+    }
+    return NULL;
+}
+
+// Finds (loading or refreshing as needed) the entry for images/<name>. On
+// success image_cache_lock is left held for reading so the entry's responses
+// stay valid; the caller releases it. Returns NULL, unlocked, otherwise.
+static CachedImage *lock_cached_image(const char *name) {
+    if (!valid_image_name(name)) return NULL;
+    time_t now = time(NULL);
+    pthread_rwlock_rdlock(&image_cache_lock);
+    CachedImage *image = find_cached_image(name);
+    if (image != NULL && now - image->checked_at < IMAGE_CACHE_RECHECK_SEC) return image;
+    pthread_rwlock_unlock(&image_cache_lock);
+
+    pthread_rwlock_wrlock(&image_cache_lock);
+    image = find_cached_image(name);
+    if (image != NULL && now - image->checked_at >= IMAGE_CACHE_RECHECK_SEC) {
+        char path[IMAGE_NAME_MAX + 16];
+        snprintf(path, sizeof(path), "%s/%s", UPLOAD_DIR, name);
+        struct stat st;
+        if (stat(path, &st) == 0 && st.st_mtime == image->mtime && st.st_size == image->size) {
+            image->checked_at = now;
+        } else {
+            release_cached_image(image);
+            image = NULL;
+        }
+    }
+    if (image == NULL) {
+        CachedImage *slot = NULL;
+        for (int i = 0; i < IMAGE_CACHE_MAX_ENTRIES && slot == NULL; i++) {
+            if (image_cache[i].name[0] == '\0') slot = &image_cache[i];
+        }
+        if (slot == NULL) {
+            slot = &image_cache[image_cache_next_victim];
+            image_cache_next_victim = (image_cache_next_victim + 1) % IMAGE_CACHE_MAX_ENTRIES;
+            release_cached_image(slot);
+        }
+        if (load_cached_image(slot, name)) image = slot;
+    }
+    pthread_rwlock_unlock(&image_cache_lock);
+    if (image == NULL) return NULL;
+
+    // Downgrade; the entry can only have been replaced if it was evicted meanwhile
+    pthread_rwlock_rdlock(&image_cache_lock);
+    image = find_cached_image(name);
+    if (image == NULL) pthread_rwlock_unlock(&image_cache_lock);
+    return image;
+}
+
+// Drops the entry for an image URL so the next request re-reads the file.
+void image_cache_invalidate(const char *url) {
+    size_t prefix = strlen(UPLOAD_DIR) + 2;
+    if (strncmp(url, "/" UPLOAD_DIR "/", prefix) != 0) return;
+    pthread_rwlock_wrlock(&image_cache_lock);
+    CachedImage *image = find_cached_image(url + prefix);
+    if (image != NULL) release_cached_image(image);
+    pthread_rwlock_unlock(&image_cache_lock);
+}
+
+void release_image_cache() {
+    pthread_rwlock_wrlock(&image_cache_lock);
+    for (int i = 0; i < IMAGE_CACHE_MAX_ENTRIES; i++) {
+        release_cached_image(&image_cache[i]);
+    }
+    pthread_rwlock_unlock(&image_cache_lock);
+}
+
+// Writes the URL a page should use for an image: local photos get their
+// content version appended so browsers can cache them for good.
+void versioned_image_url(const char *url, char *out, size_t out_size) {
+    size_t prefix = strlen(UPLOAD_DIR) + 2;
+    CachedImage *image = NULL;
+    if (strncmp(url, "/" UPLOAD_DIR "/", prefix) == 0) image = lock_cached_image(url + prefix);
+    if (image != NULL) {
+        snprintf(out, out_size, "%s?v=%s", url, image->version);
+        pthread_rwlock_unlock(&image_cache_lock);
+    } else {
+        snprintf(out, out_size, "%s", url);
+    }
+}
+
+
+// --- HTML/SVG Generation ---
+#define VOTER_LIST_PREVIEW_LIMIT 20
+#define VOTER_LIST_MAX_LIMIT 500
+
+enum voter_filter { VOTER_FILTER_ALL, VOTER_FILTER_VOTED, VOTER_FILTER_NOT_VOTED };
+
+// MODIFIED: SVG Bar chart now includes party name
+void generate_results_svg(PageBuffer *out, const Candidate *candidates, int num_candidates) {
+    int max_votes = 0;
+    for (int i = 0; i < num_candidates; i++) {
+        if (candidates[i].votes > max_votes) max_votes = candidates[i].votes;
+    }
+    if (max_votes == 0) max_votes = 1;
+
+    int chart_width = 500;
+    int bar_height = 30;
+    int bar_spacing = 15;
+    int chart_height = (num_candidates > 0) ? (num_candidates * (bar_height + bar_spacing)) : (bar_height + bar_spacing);
+
+    page_appendf(out, "<svg width='100%%' viewBox='0 0 %d %d' xmlns='http://www.w3.org/2000/svg' font-family='Inter, sans-serif'>"
+                      "<style>"
+                      ".bar-rect { transition: width 0.6s ease-out, fill 0.2s ease-in-out; fill: %s; }"
+                      ".bar-group:hover .bar-rect { fill: %s; }"
+                      "</style>", 
+                      chart_width, chart_height, "#3B82F6", "#2563EB");
+
+    for (int i = 0; i < num_candidates; i++) {
+        // MODIFIED: bar_width calculation changed to allow more space for text
+        int bar_width = (int)(((float)candidates[i].votes / max_votes) * (chart_width - 250)); // Was -150
+        if (bar_width < 1) bar_width = 1;
+        int y_pos = i * (bar_height + bar_spacing);
+
+        // MODIFIED: Title and text now include party name
+        page_appendf(out, "<g class='bar-group' data-candidate='%d' transform='translate(0 %d)'>"
+                             "<title>%s (%s): %d votes</title>"
+                             "<rect width='%d' height='%d' rx='6' class='bar-rect'></rect>"
+                             "<text x='%d' y='20' fill='#1F2937' font-size='14' font-weight='600'>%s (%s)</text>"
+                             "<text x='%d' y='20' fill='#1F2937' font-size='14' font-weight='bold'>%d</text>"
+                             "</g>", 
+                             candidates[i].id, y_pos, 
+                             candidates[i].name, candidates[i].party, candidates[i].votes,
+                             bar_width, bar_height,
+                             bar_width + 10, candidates[i].name, candidates[i].party,
+                             chart_width - 50, candidates[i].votes);
+    }
+    
+    if (num_candidates == 0) {
+        page_append(out, "<text x='10' y='20' fill='#6B7280'>No candidates have been added yet.</text>");
+    }
+
+    page_append(out, "</svg>");
+}
+
+void generate_turnout_gauge_svg(PageBuffer *out, int cast_votes, int registered_voters) {
+    float turnout_percent = 0.0;
+    if (registered_voters > 0) {
+        turnout_percent = ((float)cast_votes / (float)registered_voters);
+    }
+    if (turnout_percent > 1.0) turnout_percent = 1.0; 
+
+    int cx = 100, cy = 100, radius = 80, stroke_width = 20;
+    float circumference = M_PI * radius; 
+    float offset = circumference * (1.0 - turnout_percent);
+    
+    page_appendf(out,
+        "<svg id='live-turnout' width='100%%' viewBox='0 0 200 120' xmlns='http://www.w3.org/2000/svg' font-family='Inter, sans-serif'>"
+        " <style>"
+        "  .gauge-bg { fill: none; stroke: #E5E7EB; stroke-width: %d; }"
+        "  .gauge-fg { fill: none; stroke: #10B981; stroke-width: %d; stroke-dasharray: %f; stroke-dashoffset: %f; stroke-linecap: round; transition: stroke-dashoffset 0.8s ease-out; }"
+        "  .gauge-text { fill: #1F2937; font-size: 32px; font-weight: 800; text-anchor: middle; }"
+        "  .gauge-subtext { fill: #6B7280; font-size: 14px; font-weight: 500; text-anchor: middle; }"
+        " </style>"
+        " <path class='gauge-bg' d='M %d %d A %d %d 0 0 1 %d %d' />"
+        " <path class='gauge-fg' d='M %d %d A %d %d 0 0 1 %d %d' />"
+        " <text x='100' y='90' class='gauge-text'>%.0f%%</text>"
+        " <text x='100' y='110' class='gauge-subtext'>%d / %d Voters</text>"
+        "</svg>",
+        stroke_width, stroke_width, circumference, offset,
+        cx - radius, cy, radius, radius, cx + radius, cy,
+        cx - radius, cy, radius, radius, cx + radius, cy,
+        turnout_percent * 100.0,
+        cast_votes, registered_voters
+    );
+}
+
+// MODIFIED: Doughnut chart legend now includes party name
+void generate_doughnut_chart_svg(PageBuffer *out, const Candidate *candidates, int num_candidates, int total_votes) {
+    float total_votes_safe = (total_votes == 0) ? 1.0 : (float)total_votes;
+    
+    const char *colors[] = {"#3B82F6", "#8B5CF6", "#10B981", "#F59E0B", "#EF4444", "#6366F1", "#EC4899", "#14B8A6"};
+    int num_colors = sizeof(colors) / sizeof(colors[0]);
+
+    int cx = 100, cy = 100, radius = 80, stroke_width = 20;
+    float circumference = 2 * M_PI * radius;
+    float current_offset = 0;
+    
+    page_appendf(out,
+        "<div class='flex flex-col md:flex-row items-center justify-between gap-6'>"
+        " <div class='relative w-48 h-48'>"
+        "  <svg width='100%%' height='100%%' viewBox='0 0 200 200' xmlns='http://www.w3.org/2000/svg' style='transform: rotate(-90deg)'>"
+        "   <style>.slice { fill: none; stroke-width: %d; stroke-linecap: butt; transition: stroke-dashoffset 0.6s ease-out; }</style>",
+        stroke_width);
+    
+    for (int i = 0; i < num_candidates; i++) {
+        float percent = (float)candidates[i].votes / total_votes_safe;
+        float dash_length = circumference * percent;
+        float dash_gap = circumference - dash_length;
+
+        page_appendf(out,
+            "<circle class='slice' cx='%d' cy='%d' r='%d' stroke='%s' stroke-dasharray='%f %f' stroke-dashoffset='-%f' />",
+            cx, cy, radius, colors[i % num_colors], dash_length, dash_gap, current_offset);
+        
+        current_offset += dash_length;
+    }
+    
+    page_appendf(out,
+        "  </svg>"
+        "  <div class='absolute inset-0 flex flex-col items-center justify-center'>"
+        "   <span class='text-3xl font-extrabold text-gray-900'>%d</span>"
+        "   <span class='text-sm font-medium text-gray-500'>Total Votes</span>"
+        "  </div>"
+        " </div>"
+        " <div class='flex-grow pl-6 space-y-2'>",
+        total_votes);
+
+    for (int i = 0; i < num_candidates; i++) {
+        float percent = (float)candidates[i].votes / total_votes_safe * 100.0;
+        // MODIFIED: Legend now includes party name
+        page_appendf(out,
+            "<div class='flex items-center justify-between text-sm'>"
+            " <div class='flex items-center'>"
+            "  <span class='w-3 h-3 rounded-full mr-2' style='background-color: %s;'></span>"
+            "  <span class='font-medium text-gray-700'>%s (%s)</span>"
+            " </div>"
+            " <span class='font-bold text-gray-900'>%.0f%%</span>"
+            "</div>",
+            colors[i % num_colors], candidates[i].name, candidates[i].party, percent);
+    }
+    
+    if (num_candidates == 0) {
+        page_append(out, "<span class='text-sm text-gray-500'>No votes cast yet.</span>");
+    }
+
+    page_append(out, "</div></div>");
+}
+
+// Registry index of the `skip`-th voter (counting from 0) whose voted bit is
+// `want_voted`, or `total` if there are not that many. Whole bitmap bytes are
+// skipped with a popcount, so a deep page costs offset/8 byte reads.
+// Caller holds voters_lock.
+static int skip_voters_by_status(int total, long skip, int want_voted) {
+    int idx = 0;
+    while (idx + 8 <= total) {
+        int voted = __builtin_popcount(__atomic_load_n(&voted_bitmap[idx >> 3], __ATOMIC_RELAXED));
+        int matching = want_voted ? voted : 8 - voted;
+        if (matching > skip) break;
+        skip -= matching;
+        idx += 8;
+    }
+    for (; idx < total; idx++) {
+        if ((VOTED_BIT_IS_SET(idx) != 0) != want_voted) continue;
+        if (skip-- == 0) break;
+    }
+    return idx;
+}
+
+// One page of the registry, in voters.txt order, as a dashboard HTML fragment
+// or as JSON. `offset` counts only voters that pass the filter. The page is
+// read straight from the in-memory registry, so it costs the page size plus
+// the bitmap skip, however large the roll is.
+void generate_voter_page(PageBuffer *out, long offset, int limit, int filter, int as_json) {
+    pthread_rwlock_rdlock(&voters_lock);
+    int total = num_registered_voters;
+    int voted = __atomic_load_n(&num_voters_voted, __ATOMIC_RELAXED);
+    long matching = (filter == VOTER_FILTER_VOTED) ? voted : (filter == VOTER_FILTER_NOT_VOTED) ? total - voted : total;
+    int idx;
+    if (filter == VOTER_FILTER_ALL) {
+        idx = (offset < total) ? (int)offset : total;
+    } else {
+        idx = skip_voters_by_status(total, offset, filter == VOTER_FILTER_VOTED);
+    }
+
+    if (as_json) {
+        page_appendf(out, "{\"offset\":%ld,\"limit\":%d,\"total\":%ld,\"voters\":[", offset, limit, matching);
+    } else {
+        long first = (offset < matching) ? offset + 1 : matching;
+        long last = (offset + limit < matching) ? offset + limit : matching;
+        page_appendf(out, "<p class='text-xs text-gray-500 mb-2' data-total='%ld'>Showing %ld-%ld of %ld</p>", matching, first, last, matching);
+    }
+    int shown = 0;
+    for (; idx < total && shown < limit; idx++) {
+        int has_voted = VOTED_BIT_IS_SET(idx) != 0;
+        if (filter != VOTER_FILTER_ALL && has_voted != (filter == VOTER_FILTER_VOTED)) continue;
+        char aadhar[20];
+        voter_aadhar(idx, aadhar);
+        const char *name = voter_name(idx);
+        if (as_json) {
+            page_append(out, shown > 0 ? ",{\"aadhar\":\"" : "{\"aadhar\":\"");
+            page_append_json(out, aadhar);
+            page_append(out, "\",\"name\":\"");
+            page_append_json(out, name);
+            page_appendf(out, "\",\"voted\":%s}", has_voted ? "true" : "false");
+        } else {
+            if (shown == 0) page_append(out, "<ul class='space-y-2'>");
+            page_append(out, "<li class='flex justify-between items-center text-sm bg-gray-50 p-2 rounded'>"
+                             " <span class='font-medium text-gray-700'>");
+            page_append_html(out, name);
+            page_appendf(out, "%s</span> <span class='text-gray-500'>", has_voted ? " <span class='text-green-600 text-xs'>(voted)</span>" : "");
+            page_append_html(out, aadhar);
+            page_append(out, "</span></li>");
+        }
+        shown++;
+    }
+    pthread_rwlock_unlock(&voters_lock);
+
+    if (as_json) {
+        page_append(out, "]}");
+    } else if (shown > 0) {
+        page_append(out, "</ul>");
+    } else if (total == 0) {
+        page_append(out, "<p class='text-sm text-gray-500 text-center py-4'>No voters have been registered yet.</p>");
+    } else {
+        page_append(out, "<p class='text-sm text-gray-500 text-center py-4'>No voters on this page.</p>");
+    }
+}
+
+
+// The shell is written in two halves so page bodies can be generated straight
+// into the output between them: html_shell_begin() opens <main>, html_shell_end() closes it.
+void html_shell_begin(PageBuffer *out, const char* title, const char* active_page, const char* flash_message) {
+    char nav_home_class[128] = "text-gray-700 font-medium hover:text-blue-600 transition duration-200";
+    char nav_admin_class[128] = "text-gray-700 font-medium hover:text-blue-600 transition duration-200";
+
+    if (active_page && 0 == strcmp(active_page, "Home")) {
+        strcpy(nav_home_class, "text-blue-600 font-bold");
+    } else if (active_page && 0 == strcmp(active_page, "Admin")) {
+        strcpy(nav_admin_class, "text-blue-600 font-bold");
+    }
+
+    const char* flash_html_bg = NULL;
+    if (flash_message && flash_message[0] != '\0') {
+        const char* flash_bg = (strstr(flash_message, "Success") || strstr(flash_message, "added") || strstr(flash_message, "Started") || strstr(flash_message, "Stopped") || strstr(flash_message, "Reset") || strstr(flash_message, "Set")) 
+                               ? "bg-green-100 border-green-500 text-green-700" 
+                               : "bg-red-100 border-red-500 text-red-700";
+        flash_html_bg = flash_bg;
+    }
+
+    const char* svg_logo = 
+        "<a href='/' class='flex items-center space-x-2'>"
+        " <svg class='w-8 h-8 text-indigo-700' xmlns='http://www.w3.org/2000/svg' viewBox='0 0 24 24' fill='currentColor'>"
+        "  <path d='M11.25 4.5A2.25 2.25 0 109 6.75V15h1.5V6.75A2.25 2.25 0 0011.25 4.5z' />"
+        "  <path fill-rule='evenodd' d='M12 2.25c-5.385 0-9.75 4.365-9.75 9.75s4.365 9.75 9.75 9.75 9.75-4.365 9.75-9.75S17.385 2.25 12 2.25zM9 15.75H6v-3a.75.75 0 00-1.5 0v3H3a.75.75 0 000 1.5h1.5v3a.75.75 0 001.5 0v-3h3a.75.75 0 000-1.5zm6-3.75a.75.75 0 100-1.5.75.75 0 000 1.5zM15 15a.75.75 0 100-1.5.75.75 0 000 1.5zM18 12a.75.75 0 100-1.5.75.75 0 000 1.5z' clip-rule='evenodd' />"
+        " </svg>"
+        " <span class='text-2xl font-bold text-indigo-700'>E-Voting</span>"
+        "</a>";
+        
+    page_appendf(out,
+        "<!DOCTYPE html><html lang='en'><head><meta charset='UTF-8'><meta name='viewport' content='width=device-width, initial-scale=1.0'>"
+        "<title>%s</title><script src='https://cdn.tailwindcss.com'></script>"
+        "<link href='https://fonts.googleapis.com/css2?family=Inter:wght@400;500;600;700;800&display=swap' rel='stylesheet'>"
+        "<style>"
+        " body { font-family: 'Inter', sans-serif; padding-top: 80px; }"
+        " @keyframes fadeIn { from { opacity: 0; transform: translateY(20px); } to { opacity: 1; transform: translateY(0); } }"
+        " .fade-in { animation: fadeIn 0.8s ease-out forwards; }"
+        " .has-[:checked]:ring-2 { box-shadow: 0 0 0 2px #3B82F6; }"
+        " .backdrop-blur-xl { backdrop-filter: blur(24px); -webkit-backdrop-filter: blur(24px); }"
+        " summary { cursor: pointer; list-style: none; } "
+        " summary::-webkit-details-marker { display: none; } "
+        " details[open] summary .arrow { transform: rotate(90deg); } "
+        " .arrow { transition: transform 0.2s; display: inline-block; }"
+        " .aspect-\\[3\\/4\\] { aspect-ratio: 3 / 4; }" // NEW: Custom aspect ratio class
+        "</style></head>"
+        "<body class='bg-gradient-to-br from-slate-100 to-blue-50 min-h-screen p-4'>"
+        
+        "<nav class='fixed top-0 left-0 right-0 bg-white/70 backdrop-blur-xl shadow-lg z-50'>"
+        " <div class='max-w-6xl mx-auto px-4'>"
+        "  <div class='flex justify-between items-center h-16'>"
         "   %s"
+        "   <div class='flex space-x-6'>"
+        "    <a href='/' class='%s'>Home</a>"
+        "    <a href='/admin' class='%s'>Admin</a>"
+        "   </div>"
+        "  </div>"
+        " </div>"
+        "</nav>",
+        title, svg_logo, nav_home_class, nav_admin_class);
+
+    if (flash_html_bg != NULL) { // Flash Message
+        page_appendf(out,
+            "<div class='fade-in fixed top-20 left-1/2 -translate-x-1/2 z-[100] px-6 py-3 rounded-xl border %s shadow-lg'>"
+            " <p class='font-semibold'>%s</p>"
+            "</div>", flash_html_bg, flash_message);
+    }
+    page_append(out, "<main class='w-full'>"); // Page Content WRAPPED in main
+}
+
+void html_shell_end(PageBuffer *out) {
+    page_append(out, "</main></body></html>");
+}
+
+void generate_message_page(PageBuffer *out, const char* title, const char* message, int is_success) {
+    const char* success_svg = 
+        "<svg class='w-16 h-16 text-green-500 mx-auto' fill='none' stroke='currentColor' viewBox='0 0 24 24' xmlns='http://www.w3.org/2000/svg'>"
+        "<path stroke-linecap='round' stroke-linejoin='round' stroke-width='2' d='M9 12l2 2 4-4m6 2a9 9 0 11-18 0 9 9 0 0118 0z'></path></svg>";
+    const char* error_svg = 
+        "<svg class='w-16 h-16 text-red-500 mx-auto' fill='none' stroke='currentColor' viewBox='0 0 24 24' xmlns='http://www.w3.org/2000/svg'>"
+        "<path stroke-linecap='round' stroke-linejoin='round' stroke-width='2' d='M10 14l2-2m0 0l2-2m-2 2l-2-2m2 2l2 2m7-2a9 9 0 11-18 0 9 9 0 0118 0z'></path></svg>";
+    
+    html_shell_begin(out, title, "Message", NULL);
+    page_appendf(out,
+        "<div class='flex items-center justify-center' style='min-height: calc(100vh - 80px);'>"
+        "<div class='fade-in bg-white/70 backdrop-blur-xl rounded-2xl shadow-2xl p-8 max-w-lg text-center'>"
+        "<div class='mb-4'>%s</div>"
+        "<h1 class='text-3xl font-bold %s mb-4'>%s</h1>"
+        "<p class='text-gray-700 text-lg'>%s</p>"
+        "<div class='mt-8'><a href='/' class='text-blue-600 font-semibold hover:underline transition duration-200'>&larr; Go Back to Portal</a></div></div></div>",
+        is_success ? success_svg : error_svg,
+        is_success ? "text-gray-900" : "text-gray-900", title, message);
+    html_shell_end(out);
+}
+
+// MODIFIED: generate_voting_page now has 3:4 aspect ratio and displays party name
+void generate_voting_page(PageBuffer *out) {
+    char election_state[20];
+    char election_name[100];
+    copy_election_state(election_state);
+    copy_election_name(election_name);
+
+    if (strcmp(election_state, "LIVE") != 0) {
+        const char* title = (strcmp(election_state, "PREP") == 0) ? "Voting Has Not Started" : "Voting Has Closed";
+        const char* message = (strcmp(election_state, "PREP") == 0) 
+            ? "The election is not yet open for voting. Please check back later." 
+            : "The voting period has ended. Results will be announced soon.";
+        
+        const char* info_svg = 
+            "<svg class='w-16 h-16 text-blue-500 mx-auto' fill='none' stroke='currentColor' viewBox='0 0 24 24' xmlns='http://www.w3.org/2000/svg'>"
+            "<path stroke-linecap='round' stroke-linejoin='round' stroke-width='2' d='M13 16h-1v-4h-1m1-4h.01M21 12a9 9 0 11-18 0 9 9 0 0118 0z'></path></svg>";
+        
+        html_shell_begin(out, title, "Home", NULL);
+        page_appendf(out,
+            "<div class='flex items-center justify-center' style='min-height: calc(100vh - 80px);'>"
+            "<div class='fade-in bg-white/70 backdrop-blur-xl rounded-2xl shadow-2xl p-8 max-w-lg text-center'>"
+            "<div class='mb-4'>%s</div>"
+            "<h1 class='text-3xl font-bold text-gray-900 mb-4'>%s</h1>"
+            "<p class='text-gray-700 text-lg'>%s</p>"
+            "</div></div>", info_svg, title, message);
+        html_shell_end(out);
+        return;
+    }
+
+    html_shell_begin(out, "Online Voting Portal", "Home", NULL);
+    page_appendf(out,
+        "<div class='container mx-auto p-4 md:p-8 max-w-3xl'>"
+        "<div class='fade-in bg-white/70 backdrop-blur-xl rounded-3xl shadow-2xl p-8 md:p-12'>"
+        "<h1 class='text-4xl font-extrabold text-center text-gray-900 mb-10'>%s</h1>" 
+        
+        "<div class='mb-10'><h2 class='text-2xl font-semibold mb-6 border-b border-gray-300 pb-3 text-gray-800'>Cast Your Vote</h2>"
+        "<form action='/submit_vote' method='POST' class='space-y-6'>"
+        "<div><label for='aadhar' class='block text-sm font-medium text-gray-700 mb-1'>Aadhar Number</label>"
+        "<input type='text' id='aadhar' name='aadhar' class='block w-full px-4 py-3 bg-white/80 border border-gray-300 rounded-xl shadow-sm focus:outline-none focus:ring-2 focus:ring-blue-500 focus:border-transparent' required></div>"
+        "<div><label for='name' class='block text-sm font-medium text-gray-700 mb-1'>Full Name</label>"
+        "<input type='text' id='name' name='name' class='block w-full px-4 py-3 bg-white/80 border border-gray-300 rounded-xl shadow-sm focus:outline-none focus:ring-2 focus:ring-blue-500 focus:border-transparent' required></div>"
+        
+        "<div><label class='block text-sm font-medium text-gray-700 mb-2'>Select a Candidate</label><div class='grid grid-cols-1 sm:grid-cols-2 gap-4'>",
+        election_name);
+
+    // Versioning a photo URL can read and hash the file, so no data lock is held for it
+    int num_candidates = 0;
+    Candidate *candidates = snapshot_candidates(&num_candidates);
+    for (int i = 0; i < num_candidates; i++) {
+        char image_url[sizeof(candidates[i].imageUrl) + 24];
+        versioned_image_url(candidates[i].imageUrl, image_url, sizeof(image_url));
+        page_appendf(out,
+            "<label for='cand%d' class='flex flex-col bg-white/80 rounded-xl border border-gray-200 shadow-sm cursor-pointer transition duration-300 ease-in-out hover:shadow-lg hover:border-blue-400 hover:-translate-y-1 has-[:checked]:ring-2 has-[:checked]:ring-blue-500 has-[:checked]:border-blue-500 overflow-hidden'>" 
+            
+            // MODIFIED: aspect-video changed to aspect-[3/4]
+            "<img src='%s' alt='%s' class='w-full aspect-[3/4] object-cover' onerror=\"this.src='https://placehold.co/600x800/E0E7FF/3730A3?text=3:4+IMG'; this.onerror=null;\">"
+            
+            // MODIFIED: Added Party Name
+            "<div class='flex items-center justify-between p-4'>"
+            " <div>"
+            "  <span class='text-lg font-semibold text-gray-900'>%s</span>"
+            "  <p class='text-sm text-gray-500'>%s</p>" // NEW: Party name
+            " </div>"
+            "  <input id='cand%d' name='candidate' type='radio' value='%d' class='h-5 w-5 text-blue-600 border-gray-300 focus:ring-blue-500' required>"
+            "</div>"
+            "</label>",
+            candidates[i].id, 
+            image_url, candidates[i].name,
+            candidates[i].name,
+            candidates[i].party, // NEW
+            candidates[i].id, candidates[i].id
+        );
+    }
+    free(candidates);
+    
+    page_append(out,
+        "</div></div>"
+        "<button type='submit' class='w-full bg-blue-600 text-white font-bold py-3 px-4 rounded-xl shadow-lg transform transition duration-200 hover:scale-105 hover:bg-blue-700 hover:shadow-xl focus:outline-none focus:ring-2 focus:ring-blue-500 focus:ring-offset-2'>Submit Vote</button></form></div>"
+        
+        "</div></div>");
+    html_shell_end(out);
+}
+
+void generate_admin_login_page(PageBuffer *out) {
+    html_shell_begin(out, "Admin Login", "Admin", NULL);
+    page_append(out,
+        "<div class='flex items-center justify-center' style='min-height: calc(100vh - 80px);'>"
+        "<div class='fade-in bg-white/70 backdrop-blur-xl rounded-3xl shadow-2xl p-8 md:p-12 max-w-md w-full'>"
+        "<h1 class='text-4xl font-extrabold text-center text-gray-900 mb-10'>Admin Login</h1>"
+        "<form action='/results' method='POST' class='space-y-6'>"
+        "<div><label for='password' class='block text-sm font-medium text-gray-700 mb-1'>Admin Password</label>"
+        "<input type='password' id='password' name='password' class='block w-full px-4 py-3 bg-white/80 border border-gray-300 rounded-xl shadow-sm focus:outline-none focus:ring-2 focus:ring-indigo-500 focus:border-transparent' required></div>"
+        "<button type='submit' class='w-full bg-indigo-600 text-white font-bold py-3 px-4 rounded-xl shadow-lg transform transition duration-200 hover:scale-105 hover:bg-indigo-700 hover:shadow-xl focus:outline-none focus:ring-2 focus:ring-indigo-500 focus:ring-offset-2'>Login</button></form>"
+        "</div></div>"
+    );
+    html_shell_end(out);
+}
+
+// Dashboard panels are rendered on their own so /admin/panel can serve
+// each one from a cache and admin actions can refresh only what changed.
+// The dashboard wraps each in a <div id='panel-NAME'>.
+void generate_analytics_panel(PageBuffer *out) {
+    int registered_voters = get_registered_voter_count();
+    int cast_votes = get_cast_vote_count();
+    int num_candidates = 0;
+    Candidate *candidates = snapshot_candidates(&num_candidates);
+    int total_votes = 0;
+    for (int i = 0; i < num_candidates; i++) total_votes += candidates[i].votes;
+
+    page_append(out,
+        "<div class='grid grid-cols-1 md:grid-cols-2 gap-8'>"
+        " <div class='bg-white/50 p-6 rounded-xl shadow-inner'>"
+        "  <h3 class='text-lg font-semibold text-gray-800 mb-4 text-center'>Voter Turnout</h3>"
+        "  ");
+    generate_turnout_gauge_svg(out, cast_votes, registered_voters);
+    page_append(out,
+        " </div>"
+        " <div class='bg-white/50 p-6 rounded-xl shadow-inner'>"
+        "  <h3 class='text-lg font-semibold text-gray-800 mb-4 text-center'>Vote Distribution</h3>"
+        "  ");
+    generate_doughnut_chart_svg(out, candidates, num_candidates, total_votes);
+    page_append(out,
+        " </div>"
+        "</div>");
+    free(candidates);
+}
+
+void generate_control_panel(PageBuffer *out, const char* password) {
+    char election_state[20];
+    char election_name[100];
+    copy_election_state(election_state);
+    copy_election_name(election_name);
+
+    char status_color[50];
+    if (strcmp(election_state, "LIVE") == 0) {
+        strcpy(status_color, "text-green-600"); 
+    } else if (strcmp(election_state, "CLOSED") == 0) {
+        strcpy(status_color, "text-red-600");
+    } else {
+        strcpy(status_color, "text-yellow-600"); 
+    }
+    page_append(out, "<div class='grid grid-cols-1 md:grid-cols-2 gap-8'>");
+    page_appendf(out,
+        "<div class='bg-white/50 p-6 rounded-xl shadow-inner'>"
+        " <p class='text-center text-lg mb-4'>Current Status: <span class='font-bold %s'>%s</span></p>"
+        " <div class='grid grid-cols-3 gap-4'>"
+        "  <form action='/start_election' method='POST' data-action>"
+        "   <input type='hidden' name='password' value='%s'>"
+        "   <button type='submit' class='w-full bg-green-600 text-white font-bold py-3 px-4 rounded-xl shadow-lg transform transition hover:scale-105 hover:bg-green-700' %s>START</button>"
+        "  </form>"
+        "  <form action='/stop_election' method='POST' data-action>"
+        "   <input type='hidden' name='password' value='%s'>"
+        "   <button type='submit' class='w-full bg-red-600 text-white font-bold py-3 px-4 rounded-xl shadow-lg transform transition hover:scale-105 hover:bg-red-700' %s>STOP</button>"
+        "  </form>"
+        "  <form action='/reset_election' method='POST' data-action onsubmit=\"return confirm('Are you sure you want to reset the election? This will archive all votes and clear the voter turnout list.');\">"
+        "   <input type='hidden' name='password' value='%s'>"
+        "   <button type='submit' class='w-full bg-gray-600 text-white font-bold py-3 px-4 rounded-xl shadow-lg transform transition hover:scale-105 hover:bg-gray-700' %s>RESET</button>"
+        "  </form>"
+        " </div>"
+        "</div>",
+        status_color, election_state, 
+        password, (strcmp(election_state, "LIVE") == 0) ? "disabled class='opacity-50 cursor-not-allowed w-full bg-green-600 text-white font-bold py-3 px-4 rounded-xl shadow-lg'" : "",
+        password, (strcmp(election_state, "LIVE") != 0) ? "disabled class='opacity-50 cursor-not-allowed w-full bg-red-600 text-white font-bold py-3 px-4 rounded-xl shadow-lg'" : "",
+        password, (strcmp(election_state, "LIVE") == 0) ? "disabled class='opacity-50 cursor-not-allowed w-full bg-gray-600 text-white font-bold py-3 px-4 rounded-xl shadow-lg'" : ""
+    );
+
+    page_appendf(out,
+        "<div class='bg-white/50 p-6 rounded-xl shadow-inner'>"
+        " <form action='/set_election_name' method='POST' data-action class='space-y-4'>"
+        "  <div><label for='election_name' class='block text-sm font-medium text-gray-700 mb-1'>Election Name</label>"
+        "  <input type='text' id='election_name' name='election_name' value='%s' class='block w-full px-4 py-3 bg-white/80 border border-gray-300 rounded-xl shadow-sm focus:outline-none focus:ring-2 focus:ring-blue-500' required></div>"
+        "  <input type='hidden' name='password' value='%s'>"
+        "  <button type='submit' class='w-full bg-blue-600 text-white font-bold py-3 px-4 rounded-xl shadow-lg transform transition duration-200 hover:scale-105 hover:bg-blue-700'>Set Name</button>"
+        " </form>"
+        "</div>",
+        election_name, password
+    );
+    page_append(out, "</div>");
+}
+
+void generate_results_panel(PageBuffer *out) {
+    char winner_text[256];
+    int num_candidates = 0;
+    Candidate *candidates = snapshot_candidates(&num_candidates);
+    int total_votes = 0;
+    int max_votes = -1;
+    int winner_id = -1;
+    for(int i = 0; i < num_candidates; i++) {
+        total_votes += candidates[i].votes;
+        if (candidates[i].votes > max_votes) {
+            max_votes = candidates[i].votes;
+            winner_id = i;
+        }
+    }
+    int tie = 0;
+    if(max_votes > 0) {
+        for(int i = 0; i < num_candidates; i++) {
+            if (i != winner_id && candidates[i].votes == max_votes) {
+                tie = 1;
+                break;
+            }
+        }
+    }
+    if (tie) {
+        strcpy(winner_text, "There is currently a tie.");
+    } else if (winner_id != -1 && max_votes > 0) {
+        sprintf(winner_text, "Current Winner: <span class='font-bold text-blue-700'>%s (%s)</span> with %d votes", candidates[winner_id].name, candidates[winner_id].party, max_votes);
+    } else {
+        strcpy(winner_text, "No votes have been cast yet.");
+    }
+
+    page_appendf(out,
+        "<p class='text-center text-lg text-gray-600 mb-8'>Total Votes Cast: <span id='live-total-votes' class='font-bold text-gray-900'>%d</span></p>"
+        "<div id='live-results-chart' class='bg-white/50 p-6 rounded-xl shadow-inner mb-6'>",
+        total_votes);
+    generate_results_svg(out, candidates, num_candidates);
+    page_appendf(out,
+        "</div>"
+        "<p class='text-center text-xl text-gray-800 mt-6'>%s</p>",
+        winner_text);
+    free(candidates);
+}
+
+// MODIFIED: Admin dashboard now has new "Add Party" field
+void generate_admin_dashboard_page(PageBuffer *out, const char* password, const char* flash_message) {
+    // MODIFIED: "Add Candidate" form now has "Party Name" field
+    const char* add_candidate_form = 
+        "<details class='bg-white/50 rounded-xl shadow-inner'>"
+        " <summary class='p-5 font-semibold text-lg text-gray-800 flex justify-between items-center cursor-pointer'>"
+        "  Add New Candidate"
+        "  <span class='arrow text-indigo-600'>&#9654;</span>"
+        " </summary>"
+        " <div class='p-6 border-t border-gray-200'>"
+        "  <form action='/add_candidate' method='POST' enctype='multipart/form-data' data-action class='space-y-6'>"
+        "   <input type='hidden' name='password' value='%s'>"
+        "   <div><label for='add_id' class='block text-sm font-medium text-gray-700 mb-1'>Candidate ID (must be a number)</label>"
+        "   <input type='text' id='add_id' name='add_id' class='block w-full px-4 py-3 bg-white/80 border border-gray-300 rounded-xl shadow-sm focus:outline-none focus:ring-2 focus:ring-blue-500' required></div>"
+        "   <div><label for='add_name' class='block text-sm font-medium text-gray-700 mb-1'>Candidate Name</label>"
+        "   <input type='text' id='add_name' name='add_name' class='block w-full px-4 py-3 bg-white/80 border border-gray-300 rounded-xl shadow-sm focus:outline-none focus:ring-2 focus:ring-blue-500' required></div>"
+        "   <div><label for='add_party' class='block text-sm font-medium text-gray-700 mb-1'>Party Name</label>" // NEW
+        "   <input type='text' id='add_party' name='add_party' class='block w-full px-4 py-3 bg-white/80 border border-gray-300 rounded-xl shadow-sm focus:outline-none focus:ring-2 focus:ring-blue-500' required></div>" // NEW
+        "   <div><label for='add_image_file' class='block text-sm font-medium text-gray-700 mb-1'>Candidate Image (PNG or JPG)</label>"
+        "   <input type='file' id='add_image_file' name='add_image_file' accept='image/png, image/jpeg' class='block w-full text-sm text-gray-700 file:mr-4 file:py-2 file:px-4 file:rounded-lg file:border-0 file:text-sm file:font-semibold file:bg-indigo-50 file:text-indigo-700 hover:file:bg-indigo-100' required></div>"
+        "   <p class='text-xs text-gray-500'>Max file size: 5MB.</p>"
+        "   <button type='submit' class='w-full bg-green-600 text-white font-bold py-3 px-4 rounded-xl shadow-lg transform transition duration-200 hover:scale-105 hover:bg-green-700 hover:shadow-xl focus:outline-none focus:ring-2 focus:ring-green-500'>Add Candidate</button>"
+        "  </form>"
+        " </div>"
+        "</details>";
+
+    const char* add_voter_form_template = 
+        "<details class='bg-white/50 rounded-xl shadow-inner'>"
+        " <summary class='p-5 font-semibold text-lg text-gray-800 flex justify-between items-center cursor-pointer'>"
+        "  Add New Voter"
+        "  <span class='arrow text-indigo-600'>&#9654;</span>"
+        " </summary>"
+        " <div class='p-6 border-t border-gray-200'>"
+        "  <form action='/add_voter' method='POST' data-action class='space-y-6'>"
+        "   <div><label for='add_voter_aadhar' class='block text-sm font-medium text-gray-700 mb-1'>Voter Aadhar</label>"
+        "   <input type='text' id='add_voter_aadhar' name='add_voter_aadhar' class='block w-full px-4 py-3 bg-white/80 border border-gray-300 rounded-xl shadow-sm focus:outline-none focus:ring-2 focus:ring-blue-500' required></div>"
+        "   <div><label for='add_voter_name' class='block text-sm font-medium text-gray-700 mb-1'>Voter Name</label>"
+        "   <input type='text' id='add_voter_name' name='add_voter_name' class='block w-full px-4 py-3 bg-white/80 border border-gray-300 rounded-xl shadow-sm focus:outline-none focus:ring-2 focus:ring-blue-500' required></div>"
+        "   <input type='hidden' name='password' value='%s'>"
+        "   <button type='submit' class='w-full bg-green-600 text-white font-bold py-3 px-4 rounded-xl shadow-lg transform transition duration-200 hover:scale-105 hover:bg-green-700 hover:shadow-xl focus:outline-none focus:ring-2 focus:ring-green-500'>Add Voter</button>"
+        "  </form>"
+        " </div>"
+        "</details>";
+
+    // The password field must precede the file so the upload can be checked as it streams
+    const char* import_voters_form_template = 
+        "<details class='bg-white/50 rounded-xl shadow-inner mt-4'>"
+        " <summary class='p-5 font-semibold text-lg text-gray-800 flex justify-between items-center cursor-pointer'>"
+        "  Import Voter Roll (CSV)"
+        "  <span class='arrow text-indigo-600'>&#9654;</span>"
+        " </summary>"
+        " <div class='p-6 border-t border-gray-200'>"
+        "  <form action='/import_voters' method='POST' enctype='multipart/form-data' data-action class='space-y-6'>"
+        "   <input type='hidden' name='password' value='%s'>"
+        "   <div><label for='voter_csv' class='block text-sm font-medium text-gray-700 mb-1'>Voter file (one \"Aadhar,Name\" per line)</label>"
+        "   <input type='file' id='voter_csv' name='voter_csv' accept='.csv,.txt,text/csv,text/plain' class='block w-full text-sm text-gray-700 file:mr-4 file:py-2 file:px-4 file:rounded-lg file:border-0 file:text-sm file:font-semibold file:bg-indigo-50 file:text-indigo-700 hover:file:bg-indigo-100' required></div>"
+        "   <p class='text-xs text-gray-500'>Rows already registered are skipped. Aadhar numbers must be 12 digits.</p>"
+        "   <button type='submit' class='w-full bg-green-600 text-white font-bold py-3 px-4 rounded-xl shadow-lg transform transition duration-200 hover:scale-105 hover:bg-green-700 hover:shadow-xl focus:outline-none focus:ring-2 focus:ring-green-500'>Import Voters</button>"
+        "  </form>"
+        " </div>"
+        "</details>";
+
+    html_shell_begin(out, "Admin Dashboard", "Admin", flash_message);
+    page_append(out,
+        "<div class='container mx-auto p-4 md:p-8 max-w-6xl'>"
+        "<div class='fade-in bg-white/70 backdrop-blur-xl rounded-3xl shadow-2xl p-8 md:p-12 w-full space-y-12'>"
+        "<h1 class='text-4xl font-extrabold text-gray-900 mb-0 text-center'>Admin Dashboard</h1>"
+        
+        "<section>"
+        " <h2 class='text-2xl font-semibold mb-6 border-b border-gray-300 pb-3 text-gray-800'>Data Analytics</h2>"
+        " <div id='panel-analytics'>");
+    generate_analytics_panel(out);
+    page_append(out,
+        " </div>"
+        "</section>"
+
+        "<section>"
+        " <h2 class='text-2xl font-semibold mb-6 border-b border-gray-300 pb-3 text-gray-800'>Election Control</h2>"
+        " <div id='panel-control'>");
+    generate_control_panel(out, password);
+    page_append(out,
+        " </div>"
+        "</section>"
+
+        "<section>"
+        " <h2 class='text-2xl font-semibold mb-6 border-b border-gray-300 pb-3 text-gray-800'>Live Results</h2>"
+        " <div id='panel-results'>");
+    generate_results_panel(out);
+    page_append(out,
+        " </div>"
+        "</section>"
+
+        "<section>"
+        " <h2 class='text-2xl font-semibold mb-6 border-b border-gray-300 pb-3 text-gray-800'>Manage Election Data</h2>"
+        " <div class='grid grid-cols-1 md:grid-cols-2 gap-8'>"
+        "  <div>"
+        "   <h3 class='text-lg font-semibold text-gray-800 mb-4'>Candidates</h3>"
+        "   ");
+    // Keeps the bars and turnout gauge current from /results/stream instead of re-posting the
+    // whole dashboard; EventSource cannot send headers, so it relies on the session cookie
+    page_append(out,
+        "<script>(function(){"
+        "if(!window.EventSource)return;"
+        "var es=new EventSource('/results/stream'),votes={};"
+        "function apply(d,full){"
+        " if(full)votes={};"
+        " d.tallies.forEach(function(t){votes[t[0]]=t[1];});"
+        " var max=1;for(var k in votes)if(votes[k]>max)max=votes[k];"
+        " document.getElementById('live-total-votes').textContent=d.total;"
+        " var gauge=document.getElementById('live-turnout');"
+        " if(gauge){"
+        "  var p=d.registered>0?Math.min(1,d.cast/d.registered):0,gt=gauge.querySelectorAll('text');"
+        "  gauge.querySelector('.gauge-fg').style.strokeDashoffset=Math.PI*80*(1-p);"
+        "  gt[0].textContent=Math.round(p*100)+'%';gt[1].textContent=d.cast+' / '+d.registered+' Voters';"
+        " }"
+        " document.querySelectorAll('#live-results-chart .bar-group').forEach(function(g){"
+        "  var v=votes[g.getAttribute('data-candidate')];if(v===undefined)return;"
+        "  var w=Math.max(1,Math.floor(v/max*250)),t=g.querySelectorAll('text');"
+        "  g.querySelector('rect').setAttribute('width',w);t[0].setAttribute('x',w+10);t[1].textContent=v;"
+        " });"
+        "}"
+        "es.addEventListener('snapshot',function(e){apply(JSON.parse(e.data),true);});"
+        "es.addEventListener('delta',function(e){apply(JSON.parse(e.data),false);});"
+        "})();</script>");
+    page_appendf(out, add_candidate_form, password);
+    page_append(out,
         "  </div>"
-        "  <div class='bg-white/50 p-6 rounded-xl shadow-inner'>"
-        "   <h3 class='text-lg font-semibold text-gray-800 mb-4 text-center'>Vote Distribution</h3>"
-        "   %s"
+        "  <div>"
+        "   <h3 class='text-lg font-semibold text-gray-800 mb-4'>Voters</h3>"
+        "   ");
+    page_appendf(out, add_voter_form_template, password);
+    page_appendf(out, import_voters_form_template, password);
+    page_append(out,
+        "   <div class='mt-4 bg-white/50 p-4 rounded-xl shadow-inner'>"
+        "    <div class='flex justify-between items-center mb-3'>"
+        "     <h4 class='font-semibold text-gray-700'>Registered Voter List</h4>"
+        "     <select id='voter-filter' class='text-sm border border-gray-300 rounded p-1'>"
+        "      <option value=''>All</option><option value='yes'>Voted</option><option value='no'>Not voted</option>"
+        "     </select>"
+        "    </div>"
+        "    <div id='voter-list' class='max-h-64 overflow-y-auto'>");
+    generate_voter_page(out, 0, VOTER_LIST_PREVIEW_LIMIT, VOTER_FILTER_ALL, 0);
+    page_appendf(out,
+        "    </div>"
+        "    <div class='flex justify-between mt-3 text-sm'>"
+        "     <button type='button' id='voter-prev' class='text-blue-600 hover:underline'>&larr; Previous</button>"
+        "     <button type='button' id='voter-next' class='text-blue-600 hover:underline'>Next &rarr;</button>"
+        "    </div>"
+        "   </div>"
+        // Pages through /admin/voters without reloading the dashboard
+        "<script>(function(){"
+        "var pw=document.querySelector(\"input[name='password']\"),list=document.getElementById('voter-list'),"
+        "f=document.getElementById('voter-filter'),off=0,n=%d;if(!window.fetch)return;"
+        "var h=pw&&pw.value?{'Authorization':'Bearer '+pw.value}:{};" // Otherwise the session cookie
+        "function load(o){"
+        " fetch('/admin/voters?offset='+o+'&limit='+n+'&voted='+f.value,{headers:h})"
+        " .then(function(r){if(!r.ok)throw r;return r.text();})"
+        " .then(function(h){list.innerHTML=h;off=o;}).catch(function(){});"
+        "}"
+        "document.getElementById('voter-prev').onclick=function(){if(off>0)load(Math.max(0,off-n));};"
+        "document.getElementById('voter-next').onclick=function(){"
+        " var t=list.querySelector('[data-total]');if(!t||off+n<+t.getAttribute('data-total'))load(off+n);"
+        "};"
+        "f.onchange=function(){load(0);};"
+        "})();</script>",
+        VOTER_LIST_PREVIEW_LIMIT);
+    page_append(out,
         "  </div>"
         " </div>"
         "</section>"
 
-        "<section>"
-        " <h2 class='text-2xl font-semibold mb-6 border-b border-gray-300 pb-3 text-gray-800'>Election Control</h2>"
-        " <div class='grid grid-cols-1 md:grid-cols-2 gap-8'>"
-        "  %s" 
-        "  %s"
-        " </div>"
-        "</section>"
+        "</div></div>"
+        // Runs admin actions in the background and refreshes only the panels they
+        // changed; without scripts the forms post normally and redirect back here
+        "<script>(function(){"
+        "var pw=document.querySelector(\"input[name='password']\"),h=pw&&pw.value?{'Authorization':'Bearer '+pw.value}:{};"
+        "if(!window.fetch||!window.FormData||!window.URLSearchParams)return;"
+        "function flash(m,ok){"
+        " var d=document.createElement('div');"
+        " d.className='fade-in fixed top-20 left-1/2 -translate-x-1/2 z-[100] px-6 py-3 rounded-xl border shadow-lg font-semibold '"
+        "  +(ok?'bg-green-100 border-green-500 text-green-700':'bg-red-100 border-red-500 text-red-700');"
+        " d.textContent=m;document.body.appendChild(d);setTimeout(function(){d.remove();},5000);"
+        "}"
+        "function refresh(n){"
+        " if(n==='voters'){var v=document.getElementById('voter-filter');if(v.onchange)v.onchange();return;}"
+        " fetch('/admin/panel?name='+n,{headers:h})"
+        " .then(function(r){if(!r.ok)throw r;return r.text();})"
+        " .then(function(h){document.getElementById('panel-'+n).innerHTML=h;}).catch(function(){});"
+        "}"
+        "document.addEventListener('submit',function(e){"
+        " var f=e.target;if(e.defaultPrevented||!f.hasAttribute('data-action'))return;"
+        " e.preventDefault();"
+        " var b=new FormData(f);"
+        " fetch(f.action,{method:'POST',headers:{'Accept':'application/json'},body:f.enctype==='multipart/form-data'?b:new URLSearchParams(b)})"
+        " .then(function(r){return r.json().catch(function(){return {ok:false,message:'Error: The server answered '+r.status+'.'};});})"
+        " .then(function(d){flash(d.message,d.ok);if(d.ok)f.reset();(d.panels||[]).forEach(refresh);})"
+        " .catch(function(){flash('Error: The server could not be reached.',false);});"
+        "});"
+        "})();</script>");
+    html_shell_end(out);
+}
+
+// Prometheus text exposition of the per-thread counters, summed at scrape time.
+void generate_metrics_text(PageBuffer *out) {
+    ThreadMetrics total;
+    memset(&total, 0, sizeof(total));
+    // Every field before next is an unsigned long long counter
+    unsigned long long *sum = (unsigned long long *)&total;
+    size_t num_fields = offsetof(ThreadMetrics, next) / sizeof(unsigned long long);
+
+    pthread_mutex_lock(&thread_metrics_lock);
+    for (ThreadMetrics *m = all_thread_metrics; ; m = m->next) {
+        ThreadMetrics *block = (m != NULL) ? m : &fallback_thread_metrics;
+        unsigned long long *fields = (unsigned long long *)block;
+        for (size_t i = 0; i < num_fields; i++) {
+            sum[i] += __atomic_load_n(&fields[i], __ATOMIC_RELAXED);
+        }
+        if (m == NULL) break;
+    }
+    pthread_mutex_unlock(&thread_metrics_lock);
+
+    page_append(out,
+        "# HELP voting_http_requests_total Completed HTTP requests by route.\n"
+        "# TYPE voting_http_requests_total counter\n");
+    for (int r = 0; r < NUM_ROUTES; r++) {
+        page_appendf(out, "voting_http_requests_total{route=\"%s\"} %llu\n", route_labels[r], total.requests[r]);
+    }
+    page_append(out,
+        "# HELP voting_http_request_duration_seconds Time from first request byte to response completion.\n"
+        "# TYPE voting_http_request_duration_seconds histogram\n");
+    for (int r = 0; r < NUM_ROUTES; r++) {
+        unsigned long long cumulative = 0;
+        for (int b = 0; b < NUM_LATENCY_BUCKETS; b++) {
+            cumulative += total.latency_buckets[r][b];
+            if (b < NUM_LATENCY_BUCKETS - 1) {
+                page_appendf(out, "voting_http_request_duration_seconds_bucket{route=\"%s\",le=\"%g\"} %llu\n",
+                             route_labels[r], latency_bucket_bounds[b], cumulative);
+            } else {
+                page_appendf(out, "voting_http_request_duration_seconds_bucket{route=\"%s\",le=\"+Inf\"} %llu\n",
+                             route_labels[r], cumulative);
+            }
+        }
+        page_appendf(out, "voting_http_request_duration_seconds_sum{route=\"%s\"} %.9f\n", route_labels[r], total.latency_ns[r] / 1e9);
+        page_appendf(out, "voting_http_request_duration_seconds_count{route=\"%s\"} %llu\n", route_labels[r], cumulative);
+    }
+
+    page_append(out,
+        "# HELP voting_file_lock_acquisitions_total File locks taken by file.\n"
+        "# TYPE voting_file_lock_acquisitions_total counter\n");
+    for (int f = 0; f < NUM_LOCKED_FILES; f++) {
+        page_appendf(out, "voting_file_lock_acquisitions_total{file=\"%s\"} %llu\n", locked_file_labels[f], total.lock_acquisitions[f]);
+    }
+    page_append(out,
+        "# HELP voting_file_lock_contended_total File locks that had to wait for another holder.\n"
+        "# TYPE voting_file_lock_contended_total counter\n");
+    for (int f = 0; f < NUM_LOCKED_FILES; f++) {
+        page_appendf(out, "voting_file_lock_contended_total{file=\"%s\"} %llu\n", locked_file_labels[f], total.lock_contended[f]);
+    }
+    page_append(out,
+        "# HELP voting_file_lock_wait_seconds_total Time spent blocked acquiring file locks.\n"
+        "# TYPE voting_file_lock_wait_seconds_total counter\n");
+    for (int f = 0; f < NUM_LOCKED_FILES; f++) {
+        page_appendf(out, "voting_file_lock_wait_seconds_total{file=\"%s\"} %.9f\n", locked_file_labels[f], total.lock_wait_ns[f] / 1e9);
+    }
+
+    page_appendf(out,
+        "# HELP voting_votes_committed_total Ballots made durable in the ledger.\n"
+        "# TYPE voting_votes_committed_total counter\n"
+        "voting_votes_committed_total %llu\n"
+        "# HELP voting_ballot_commit_batches_total Ledger syncs; each commits one or more ballots.\n"
+        "# TYPE voting_ballot_commit_batches_total counter\n"
+        "voting_ballot_commit_batches_total %llu\n",
+        total.votes_committed, total.ballot_batches);
+    page_append(out,
+        "# HELP voting_ballots_rejected_total Vote submissions that were not recorded, by reason.\n"
+        "# TYPE voting_ballots_rejected_total counter\n");
+    for (int i = 0; i < NUM_REJECT_REASONS; i++) {
+        page_appendf(out, "voting_ballots_rejected_total{reason=\"%s\"} %llu\n", rejection_labels[i], total.ballots_rejected[i]);
+    }
+
+    page_appendf(out,
+        "# HELP voting_connections_total Connections accepted.\n"
+        "# TYPE voting_connections_total counter\n"
+        "voting_connections_total %llu\n"
+        "# HELP voting_connections_in_flight Connections currently open.\n"
+        "# TYPE voting_connections_in_flight gauge\n"
+        "voting_connections_in_flight %lld\n",
+        total.connections_opened, (long long)(total.connections_opened - total.connections_closed));
+    page_append(out,
+        "# HELP voting_requests_shed_total Requests turned away by admission control, by reason.\n"
+        "# TYPE voting_requests_shed_total counter\n");
+    for (int i = 0; i < NUM_SHED_REASONS; i++) {
+        page_appendf(out, "voting_requests_shed_total{reason=\"%s\"} %llu\n", shed_labels[i], total.requests_shed[i]);
+    }
+}
+
+// Body of GET /api/results: tallies, turnout, leader and election state.
+void generate_results_json(PageBuffer *out) {
+    char election_state[20];
+    char election_name[100];
+    copy_election_state(election_state);
+    copy_election_name(election_name);
+    int registered_voters = get_registered_voter_count();
+    int cast_votes = get_cast_vote_count();
+    int num_candidates = 0;
+    Candidate *candidates = snapshot_candidates(&num_candidates);
+
+    int total_votes = 0, leader = -1, tie = 0;
+    for (int i = 0; i < num_candidates; i++) {
+        total_votes += candidates[i].votes;
+        if (leader == -1 || candidates[i].votes > candidates[leader].votes) {
+            leader = i;
+            tie = 0;
+        } else if (candidates[i].votes == candidates[leader].votes) {
+            tie = 1;
+        }
+    }
+    if (leader != -1 && candidates[leader].votes == 0) leader = -1;
 
-        "<section>"
-        " <h2 class='text-2xl font-semibold mb-6 border-b border-gray-300 pb-3 text-gray-800'>Live Results</h2>"
-        " <p class='text-center text-lg text-gray-600 mb-8'>Total Votes Cast: <span class='font-bold text-gray-900'>%d</span></p>"
-        " <div class='bg-white/50 p-6 rounded-xl shadow-inner mb-6'>%s</div>"
-        " <p class='text-center text-xl text-gray-800 mt-6'>%s</p>"
-        "</section>"
+    page_append(out, "{\"election\":\"");
+    page_append_json(out, election_name);
+    page_append(out, "\",\"state\":\"");
+    page_append_json(out, election_state);
+    page_appendf(out, "\",\"registered\":%d,\"voted\":%d,\"turnout\":%.2f,\"total_votes\":%d,\"tie\":%s,\"leader\":",
+                 registered_voters, cast_votes, registered_voters > 0 ? 100.0 * cast_votes / registered_voters : 0.0,
+                 total_votes, (leader != -1 && tie) ? "true" : "false");
+    if (leader != -1 && !tie) {
+        page_appendf(out, "%d", candidates[leader].id);
+    } else {
+        page_append(out, "null");
+    }
+    page_append(out, ",\"candidates\":[");
+    for (int i = 0; i < num_candidates; i++) {
+        page_appendf(out, "%s{\"id\":%d,\"name\":\"", i > 0 ? "," : "", candidates[i].id);
+        page_append_json(out, candidates[i].name);
+        page_append(out, "\",\"party\":\"");
+        page_append_json(out, candidates[i].party);
+        page_appendf(out, "\",\"votes\":%d}", candidates[i].votes);
+    }
+    page_append(out, "]}");
+    free(candidates);
+}
 
-        "<section>"
-        " <h2 class='text-2xl font-semibold mb-6 border-b border-gray-300 pb-3 text-gray-800'>Manage Election Data</h2>"
-        " <div class='grid grid-cols-1 md:grid-cols-2 gap-8'>"
-        "  <div>"
-        "   <h3 class='text-lg font-semibold text-gray-800 mb-4'>Candidates</h3>"
-        "   %s"
-        "  </div>"
-        "  <div>"
-        "   <h3 class='text-lg font-semibold text-gray-800 mb-4'>Voters</h3>"
-        "   %s"
-        "   <div class='mt-4 bg-white/50 p-4 rounded-xl shadow-inner max-h-64 overflow-y-auto'>"
-        "    <h4 class='font-semibold text-gray-700 mb-3'>Registered Voter List</h4>"
-        "    %s"
-        "   </div>"
-        "  </div>"
-        " </div>"
-        "</section>"
+// --- Page Cache ---
+// Pages that only change with a version counter are rendered once per
+// version, compressed once per encoding, and served from shared MHD
+// responses, so each request only queues a reference. Clients revalidate
+// with If-None-Match and get a 304 while the version is unchanged. Pages that
+// only change when an admin edits the election get the strongest level;
+// those that follow the results are rebuilt after every committed batch
+// during voting, so they use a middle level that keeps a rebuild cheap.
+// Everything else is compressed per response at a fast level.
+#define CACHED_PAGE_GZIP_LEVEL 9
+#define CACHED_PAGE_BROTLI_QUALITY 11
+#define RESULTS_PAGE_GZIP_LEVEL 6
+#define RESULTS_PAGE_BROTLI_QUALITY 5
+#define DYNAMIC_PAGE_GZIP_LEVEL 1
+#define DYNAMIC_PAGE_BROTLI_QUALITY 4
+#define DYNAMIC_PAGE_COMPRESS_MIN 1024 // Smaller bodies fit in a packet anyway
+#define PUBLIC_PAGE_CACHE_CONTROL "no-cache"
+#define ADMIN_PAGE_CACHE_CONTROL "private, no-cache" // Admin-only content
+
+enum content_encoding { ENCODING_IDENTITY, ENCODING_GZIP, ENCODING_BROTLI, NUM_ENCODINGS };
+static const char *encoding_names[NUM_ENCODINGS] = { NULL, "gzip", "br" };
+static const char *encoding_etag_suffixes[NUM_ENCODINGS] = { "", "-gz", "-br" };
+
+enum compression_level { COMPRESS_STRONGEST, COMPRESS_RESULTS, COMPRESS_FAST };
+
+typedef struct {
+    void (*render)(PageBuffer *out);
+    unsigned long (*current_version)(void);
+    const char *content_type;
+    const char *cache_control; // NULL for PUBLIC_PAGE_CACHE_CONTROL
+    enum compression_level compression;
+    pthread_rwlock_t lock;
+    unsigned long version;   // current_version() this entry was built from (0 = never built)
+    char etag[NUM_ENCODINGS][48];
+    struct MHD_Response *body[NUM_ENCODINGS]; // NULL where that encoding failed
+    struct MHD_Response *not_modified[NUM_ENCODINGS];
+} CachedPage;
+
+static unsigned long voting_page_version(void) {
+    return __atomic_load_n(&page_content_version, __ATOMIC_ACQUIRE);
+}
+
+// The results JSON also shows the election name and state, so it follows
+// both counters. Both only grow, so their sum moves whenever either does.
+static unsigned long results_api_version(void) {
+    return __atomic_load_n(&page_content_version, __ATOMIC_ACQUIRE) + __atomic_load_n(&results_version, __ATOMIC_ACQUIRE);
+}
+
+CachedPage voting_page_cache = { .render = generate_voting_page, .current_version = voting_page_version,
+                                 .content_type = "text/html", .lock = PTHREAD_RWLOCK_INITIALIZER };
+CachedPage admin_login_cache = { .render = generate_admin_login_page, .current_version = voting_page_version,
+                                 .content_type = "text/html", .lock = PTHREAD_RWLOCK_INITIALIZER };
+CachedPage results_api_cache = { .render = generate_results_json, .current_version = results_api_version,
+                                 .content_type = "application/json", .compression = COMPRESS_RESULTS,
+                                 .lock = PTHREAD_RWLOCK_INITIALIZER };
+
+// The cached admin pages are served to session holders, whose forms are
+// authorised by the cookie, so they never carry the password.
+static void render_control_panel(PageBuffer *out) {
+    generate_control_panel(out, "");
+}
+
+static void render_admin_dashboard(PageBuffer *out) {
+    generate_admin_dashboard_page(out, "", NULL);
+}
+
+enum dashboard_panel { PANEL_ANALYTICS, PANEL_CONTROL, PANEL_RESULTS, NUM_DASHBOARD_PANELS };
+static const char *dashboard_panel_names[NUM_DASHBOARD_PANELS] = { "analytics", "control", "results" };
+
+CachedPage admin_dashboard_cache = { .render = render_admin_dashboard, .current_version = results_api_version,
+                                     .content_type = "text/html", .cache_control = ADMIN_PAGE_CACHE_CONTROL,
+                                     .compression = COMPRESS_RESULTS, .lock = PTHREAD_RWLOCK_INITIALIZER };
+CachedPage dashboard_panel_caches[NUM_DASHBOARD_PANELS] = {
+    [PANEL_ANALYTICS] = { .render = generate_analytics_panel, .current_version = results_api_version,
+                          .content_type = "text/html", .cache_control = ADMIN_PAGE_CACHE_CONTROL,
+                          .compression = COMPRESS_RESULTS, .lock = PTHREAD_RWLOCK_INITIALIZER },
+    [PANEL_CONTROL] = { .render = render_control_panel, .current_version = voting_page_version,
+                        .content_type = "text/html", .cache_control = ADMIN_PAGE_CACHE_CONTROL, .lock = PTHREAD_RWLOCK_INITIALIZER },
+    [PANEL_RESULTS] = { .render = generate_results_panel, .current_version = results_api_version,
+                        .content_type = "text/html", .cache_control = ADMIN_PAGE_CACHE_CONTROL,
+                        .compression = COMPRESS_RESULTS, .lock = PTHREAD_RWLOCK_INITIALIZER },
+};
+
+// Compresses into a malloc'd buffer in gzip framing. Returns 1 on success.
+int gzip_compress(const char *data, size_t len, int level, char **out, size_t *out_len) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (deflateInit2(&zs, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) return 0;
+    uLong bound = deflateBound(&zs, (uLong)len);
+    char *buffer = malloc(bound);
+    if (buffer == NULL) {
+        deflateEnd(&zs);
+        return 0;
+    }
+    zs.next_in = (Bytef *)data;
+    zs.avail_in = (uInt)len;
+    zs.next_out = (Bytef *)buffer;
+    zs.avail_out = (uInt)bound;
+    if (deflate(&zs, Z_FINISH) != Z_STREAM_END) {
+        deflateEnd(&zs);
+        free(buffer);
+        return 0;
+    }
+    *out = buffer;
+    *out_len = zs.total_out;
+    deflateEnd(&zs);
+    return 1;
+}
+
+// Compresses into a malloc'd brotli stream. Always fails when built without USE_BROTLI.
+int brotli_compress(const char *data, size_t len, int quality, char **out, size_t *out_len) {
+    #ifdef USE_BROTLI
+        size_t bound = BrotliEncoderMaxCompressedSize(len);
+        char *buffer = (bound > 0) ? malloc(bound) : NULL;
+        if (buffer == NULL) return 0;
+        size_t encoded_len = bound;
+        if (!BrotliEncoderCompress(quality, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT, len, (const uint8_t *)data,
+                                   &encoded_len, (uint8_t *)buffer)) {
+            free(buffer);
+            return 0;
+        }
+        *out = buffer;
+        *out_len = encoded_len;
+        return 1;
+    #else
+        (void)data; (void)len; (void)quality; (void)out; (void)out_len;
+        return 0;
+    #endif
+}
+
+static int compress_body(int encoding, const char *data, size_t len, enum compression_level level, char **out, size_t *out_len) {
+    if (encoding == ENCODING_GZIP) {
+        int gzip_level = (level == COMPRESS_FAST) ? DYNAMIC_PAGE_GZIP_LEVEL
+                       : (level == COMPRESS_RESULTS) ? RESULTS_PAGE_GZIP_LEVEL : CACHED_PAGE_GZIP_LEVEL;
+        return gzip_compress(data, len, gzip_level, out, out_len);
+    }
+    if (encoding == ENCODING_BROTLI) {
+        int quality = (level == COMPRESS_FAST) ? DYNAMIC_PAGE_BROTLI_QUALITY
+                    : (level == COMPRESS_RESULTS) ? RESULTS_PAGE_BROTLI_QUALITY : CACHED_PAGE_BROTLI_QUALITY;
+        return brotli_compress(data, len, quality, out, out_len);
+    }
+    return 0;
+}
+
+// Parses an Accept-Encoding header for the given coding, honouring q=0.
+int client_accepts_encoding(struct MHD_Connection *connection, const char *coding) {
+    const char *header = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, MHD_HTTP_HEADER_ACCEPT_ENCODING);
+    if (header == NULL) return 0;
+    size_t coding_len = strlen(coding);
+    const char *p = header;
+    while (*p) {
+        while (*p == ' ' || *p == ',') p++;
+        const char *token = p;
+        while (*p && *p != ',' && *p != ';' && *p != ' ') p++;
+        size_t token_len = (size_t)(p - token);
+        int matches = (token_len == coding_len && strncasecmp(token, coding, coding_len) == 0);
+        double q = 1.0;
+        while (*p && *p != ',') {
+            if (*p == ';') {
+                const char *param = p + 1;
+                while (*param == ' ') param++;
+                if (param[0] == 'q' && param[1] == '=') q = atof(param + 2);
+            }
+            p++;
+        }
+        if (matches) return q > 0.0;
+    }
+    return 0;
+}
+
+// Picks brotli, then gzip, from what the client accepts and `available` (a
+// bit per content_encoding) allows.
+static int negotiate_encoding(struct MHD_Connection *connection, unsigned int available) {
+    if ((available & (1u << ENCODING_BROTLI)) && client_accepts_encoding(connection, "br")) return ENCODING_BROTLI;
+    if ((available & (1u << ENCODING_GZIP)) && client_accepts_encoding(connection, "gzip")) return ENCODING_GZIP;
+    return ENCODING_IDENTITY;
+}
+
+// Encodings this build can produce.
+static unsigned int supported_encodings() {
+    unsigned int encodings = (1u << ENCODING_IDENTITY) | (1u << ENCODING_GZIP);
+    #ifdef USE_BROTLI
+        encodings |= 1u << ENCODING_BROTLI;
+    #endif
+    return encodings;
+}
+
+// True when an If-None-Match header lists this ETag (or "*").
+int etag_matches(struct MHD_Connection *connection, const char *etag) {
+    const char *header = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, MHD_HTTP_HEADER_IF_NONE_MATCH);
+    if (header == NULL) return 0;
+    if (strcmp(header, "*") == 0) return 1;
+    size_t etag_len = strlen(etag);
+    const char *p = header;
+    while ((p = strstr(p, etag)) != NULL) {
+        char after = p[etag_len];
+        if (after == '\0' || after == ',' || after == ' ') return 1;
+        p += etag_len;
+    }
+    return 0;
+}
+
+static struct MHD_Response *make_cached_response(char *body, size_t len, const char *content_type, const char *cache_control,
+                                                 const char *etag, const char *encoding) {
+    struct MHD_Response *response = MHD_create_response_from_buffer(len, body, MHD_RESPMEM_MUST_FREE);
+    if (response == NULL) {
+        free(body);
+        return NULL;
+    }
+    MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_TYPE, content_type);
+    MHD_add_response_header(response, MHD_HTTP_HEADER_ETAG, etag);
+    MHD_add_response_header(response, MHD_HTTP_HEADER_CACHE_CONTROL, cache_control);
+    MHD_add_response_header(response, MHD_HTTP_HEADER_VARY, "Accept-Encoding");
+    if (encoding != NULL) {
+        MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_ENCODING, encoding);
+    }
+    return response;
+}
+
+static struct MHD_Response *make_not_modified_response(const char *cache_control, const char *etag) {
+    struct MHD_Response *response = MHD_create_response_from_buffer(0, NULL, MHD_RESPMEM_PERSISTENT);
+    if (response == NULL) return NULL;
+    MHD_add_response_header(response, MHD_HTTP_HEADER_ETAG, etag);
+    MHD_add_response_header(response, MHD_HTTP_HEADER_CACHE_CONTROL, cache_control);
+    MHD_add_response_header(response, MHD_HTTP_HEADER_VARY, "Accept-Encoding");
+    return response;
+}
+
+static void release_cached_responses(CachedPage *cache) {
+    // Connections still sending an old response hold their own reference
+    for (int e = 0; e < NUM_ENCODINGS; e++) {
+        if (cache->body[e]) MHD_destroy_response(cache->body[e]);
+        if (cache->not_modified[e]) MHD_destroy_response(cache->not_modified[e]);
+        cache->body[e] = cache->not_modified[e] = NULL;
+    }
+}
+
+// Re-renders the page for the given version. Caller holds cache->lock for writing.
+static int rebuild_cached_page(CachedPage *cache, unsigned long version) {
+    PageBuffer page = {0};
+    cache->render(&page);
+    if (page.failed || page.len == 0) {
+        page_free(&page);
+        return 0;
+    }
+    unsigned long long hash = hash_bytes(page.data, page.len);
+
+    release_cached_responses(cache);
+    const char *cache_control = (cache->cache_control != NULL) ? cache->cache_control : PUBLIC_PAGE_CACHE_CONTROL;
+    unsigned int encodings = supported_encodings();
+    for (int e = NUM_ENCODINGS - 1; e >= 0; e--) {
+        if (!(encodings & (1u << e))) continue;
+        char *body = page.data;
+        size_t body_len = page.len;
+        if (e != ENCODING_IDENTITY && !compress_body(e, page.data, page.len, cache->compression, &body, &body_len)) continue;
+        snprintf(cache->etag[e], sizeof(cache->etag[e]), "\"%lx-%016llx%s\"", version, hash, encoding_etag_suffixes[e]);
+        cache->body[e] = make_cached_response(body, body_len, cache->content_type, cache_control, cache->etag[e], encoding_names[e]);
+        cache->not_modified[e] = make_not_modified_response(cache_control, cache->etag[e]);
+    }
+    // The plain body is built last, from (and taking ownership of) page.data
+    cache->version = (cache->body[ENCODING_IDENTITY] != NULL) ? version : 0;
+    return cache->body[ENCODING_IDENTITY] != NULL;
+}
+
+// Queues the cached page (or a 304) on the connection, rebuilding it first if stale.
+// Returns MHD_NO only if the page could not be produced at all.
+enum MHD_Result serve_cached_page(struct MHD_Connection *connection, CachedPage *cache) {
+    unsigned long version = cache->current_version();
+
+    pthread_rwlock_rdlock(&cache->lock);
+    while (cache->version != version) {
+        pthread_rwlock_unlock(&cache->lock);
+        pthread_rwlock_wrlock(&cache->lock);
+        if (cache->version != version && !rebuild_cached_page(cache, version)) {
+            pthread_rwlock_unlock(&cache->lock);
+            return MHD_NO;
+        }
+        pthread_rwlock_unlock(&cache->lock);
+        pthread_rwlock_rdlock(&cache->lock);
+    }
+
+    // Queue while the read lock pins these responses; MHD takes its own reference
+    unsigned int available = 0;
+    for (int e = 0; e < NUM_ENCODINGS; e++) {
+        if (cache->body[e] != NULL) available |= 1u << e;
+    }
+    int encoding = negotiate_encoding(connection, available);
+    enum MHD_Result ret;
+    if (etag_matches(connection, cache->etag[encoding]) && cache->not_modified[encoding] != NULL) {
+        ret = MHD_queue_response(connection, MHD_HTTP_NOT_MODIFIED, cache->not_modified[encoding]);
+    } else {
+        ret = MHD_queue_response(connection, MHD_HTTP_OK, cache->body[encoding]);
+    }
+    pthread_rwlock_unlock(&cache->lock);
+    return ret;
+}
+
+
+// --- Live Results Stream ---
+// GET /results/stream?key=<admin password> is a text/event-stream of tallies.
+// One broadcaster thread turns changes into a shared, refcounted snapshot at
+// most once per results_stream_interval_ms, and every watcher copies its
+// bytes out of that same snapshot. Idle watchers stay suspended until the
+// next snapshot or heartbeat instead of being polled.
+#define DEFAULT_RESULTS_STREAM_INTERVAL_MS 500
+#define RESULTS_STREAM_HEARTBEAT_SEC 15
+#define RESULTS_STREAM_BLOCK_SIZE 4096
+
+typedef struct {
+    int refcount;        // Guarded by results_stream_mutex
+    unsigned long seq;   // One per published snapshot
+    PageBuffer full;     // "snapshot" event carrying every candidate
+    PageBuffer delta;    // "delta" event with changes since seq - 1 (empty if the candidate set changed)
+} ResultsSnapshot;
+
+typedef struct ResultsWatcher {
+    struct MHD_Connection *connection;
+    unsigned long sent_seq;        // Last snapshot fully sent (0 = none yet)
+    ResultsSnapshot *pending;      // Snapshot being sent; holds a reference
+    const PageBuffer *pending_event;
+    size_t pending_offset;
+    int suspended;
+    int heartbeat_due;
+    struct ResultsWatcher *prev, *next;
+} ResultsWatcher;
+
+long results_stream_interval_ms = DEFAULT_RESULTS_STREAM_INTERVAL_MS;
+ResultsSnapshot *current_results = NULL;
+ResultsWatcher *results_watchers = NULL;
+int results_stream_stopping = 0;
+pthread_t results_broadcaster;
+int results_broadcaster_started = 0;
+
+// Caller holds results_stream_mutex.
+static void release_results_snapshot(ResultsSnapshot *snap) {
+    if (snap != NULL && --snap->refcount == 0) {
+        page_free(&snap->full);
+        page_free(&snap->delta);
+        free(snap);
+    }
+}
+
+// Caller holds results_stream_mutex.
+static void wake_results_watchers(int heartbeat) {
+    for (ResultsWatcher *w = results_watchers; w != NULL; w = w->next) {
+        if (heartbeat) w->heartbeat_due = 1;
+        if (w->suspended) {
+            w->suspended = 0;
+            MHD_resume_connection(w->connection);
+        }
+    }
+}
+
+// Renders the current tallies as SSE events. *prev holds the candidates the
+// previous snapshot was built from and is replaced on success.
+static ResultsSnapshot *build_results_snapshot(unsigned long seq, Candidate **prev, int *prev_count) {
+    int count = 0;
+    Candidate *now = snapshot_candidates(&count);
+    pthread_rwlock_rdlock(&voters_lock);
+    int registered = num_registered_voters;
+    pthread_rwlock_unlock(&voters_lock);
+    int cast = get_cast_vote_count();
+    int total = 0;
+    for (int i = 0; i < count; i++) total += now[i].votes;
+
+    int same_set = seq > 1 && *prev_count == count;
+    for (int i = 0; same_set && i < count; i++) {
+        if ((*prev)[i].id != now[i].id) same_set = 0;
+    }
+
+    ResultsSnapshot *snap = calloc(1, sizeof(ResultsSnapshot));
+    if (snap == NULL) {
+        free(now);
+        return NULL;
+    }
+    snap->refcount = 1;
+    snap->seq = seq;
+    page_appendf(&snap->full, "id: %lu\nevent: snapshot\ndata: {\"cast\":%d,\"registered\":%d,\"total\":%d,\"tallies\":[",
+                 seq, cast, registered, total);
+    if (same_set) {
+        page_appendf(&snap->delta, "id: %lu\nevent: delta\ndata: {\"cast\":%d,\"registered\":%d,\"total\":%d,\"tallies\":[",
+                     seq, cast, registered, total);
+    }
+    int changed = 0;
+    for (int i = 0; i < count; i++) {
+        page_appendf(&snap->full, "%s[%d,%d]", i ? "," : "", now[i].id, now[i].votes);
+        if (same_set && (*prev)[i].votes != now[i].votes) {
+            page_appendf(&snap->delta, "%s[%d,%d]", changed++ ? "," : "", now[i].id, now[i].votes);
+        }
+    }
+    page_append(&snap->full, "]}\n\n");
+    if (same_set) page_append(&snap->delta, "]}\n\n");
+
+    if (snap->full.failed || snap->delta.failed) {
+        page_free(&snap->full);
+        page_free(&snap->delta);
+        free(snap);
+        free(now);
+        return NULL;
+    }
+    free(*prev);
+    *prev = now;
+    *prev_count = count;
+    return snap;
+}
+
+static void *results_broadcaster_main(void *arg) {
+    (void)arg;
+    unsigned long built_version = 0;
+    unsigned long seq = 0;
+    Candidate *prev = NULL;
+    int prev_count = 0;
+
+    pthread_mutex_lock(&results_stream_mutex);
+    while (!results_stream_stopping) {
+        if (results_version == built_version) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += RESULTS_STREAM_HEARTBEAT_SEC;
+            if (pthread_cond_timedwait(&results_changed_cond, &results_stream_mutex, &deadline) == ETIMEDOUT) {
+                // Lets idle streams notice dead peers and keeps proxies from timing out
+                wake_results_watchers(1);
+            }
+            continue;
+        }
+        unsigned long version = results_version;
+        pthread_mutex_unlock(&results_stream_mutex);
+        ResultsSnapshot *snap = build_results_snapshot(seq + 1, &prev, &prev_count);
+        pthread_mutex_lock(&results_stream_mutex);
+
+        // On failure, retry on the next change rather than spinning
+        built_version = version;
+        if (snap != NULL) {
+            seq++;
+            release_results_snapshot(current_results);
+            current_results = snap;
+            wake_results_watchers(0);
+        }
+
+        // Coalesce: changes during this pause go out together in the next snapshot
+        if (results_stream_interval_ms > 0 && !results_stream_stopping) {
+            pthread_mutex_unlock(&results_stream_mutex);
+            usleep(results_stream_interval_ms * 1000);
+            pthread_mutex_lock(&results_stream_mutex);
+        }
+    }
+    pthread_mutex_unlock(&results_stream_mutex);
+    free(prev);
+    return NULL;
+}
+
+static ssize_t results_stream_reader(void *cls, uint64_t pos, char *buf, size_t max) {
+    ResultsWatcher *w = cls;
+    (void)pos;
+    if (w->pending == NULL) {
+        pthread_mutex_lock(&results_stream_mutex);
+        if (results_stream_stopping) {
+            pthread_mutex_unlock(&results_stream_mutex);
+            return MHD_CONTENT_READER_END_OF_STREAM;
+        }
+        ResultsSnapshot *snap = current_results;
+        if (snap != NULL && snap->seq != w->sent_seq) {
+            snap->refcount++;
+            w->pending = snap;
+            // Watchers that saw the previous snapshot only need what changed
+            int can_delta = w->sent_seq != 0 && w->sent_seq + 1 == snap->seq && snap->delta.len > 0;
+            w->pending_event = can_delta ? &snap->delta : &snap->full;
+            w->pending_offset = 0;
+        } else if (w->heartbeat_due) {
+            static const char keepalive[] = ": keepalive\n\n";
+            w->heartbeat_due = 0;
+            pthread_mutex_unlock(&results_stream_mutex);
+            size_t n = sizeof(keepalive) - 1;
+            if (n > max) n = max;
+            memcpy(buf, keepalive, n);
+            return (ssize_t)n;
+        } else {
+            // Nothing new: park the connection until the broadcaster resumes it
+            w->suspended = 1;
+            MHD_suspend_connection(w->connection);
+            pthread_mutex_unlock(&results_stream_mutex);
+            return 0;
+        }
+        pthread_mutex_unlock(&results_stream_mutex);
+    }
+
+    // Published snapshots are immutable, so the copy needs no lock
+    size_t n = w->pending_event->len - w->pending_offset;
+    if (n > max) n = max;
+    memcpy(buf, w->pending_event->data + w->pending_offset, n);
+    w->pending_offset += n;
+    if (w->pending_offset == w->pending_event->len) {
+        pthread_mutex_lock(&results_stream_mutex);
+        w->sent_seq = w->pending->seq;
+        release_results_snapshot(w->pending);
+        w->pending = NULL;
+        pthread_mutex_unlock(&results_stream_mutex);
+    }
+    return (ssize_t)n;
+}
+
+static void results_stream_free(void *cls) {
+    ResultsWatcher *w = cls;
+    pthread_mutex_lock(&results_stream_mutex);
+    if (w->prev) w->prev->next = w->next;
+    else results_watchers = w->next;
+    if (w->next) w->next->prev = w->prev;
+    release_results_snapshot(w->pending);
+    pthread_mutex_unlock(&results_stream_mutex);
+    free(w);
+}
+
+enum MHD_Result serve_results_stream(struct MHD_Connection *connection) {
+    ResultsWatcher *w = calloc(1, sizeof(ResultsWatcher));
+    if (w == NULL) return MHD_NO;
+    w->connection = connection;
+    struct MHD_Response *response = MHD_create_response_from_callback(MHD_SIZE_UNKNOWN, RESULTS_STREAM_BLOCK_SIZE,
+                                                                      &results_stream_reader, w, &results_stream_free);
+    if (response == NULL) {
+        free(w);
+        return MHD_NO;
+    }
+    pthread_mutex_lock(&results_stream_mutex);
+    w->next = results_watchers;
+    if (results_watchers) results_watchers->prev = w;
+    results_watchers = w;
+    pthread_mutex_unlock(&results_stream_mutex);
+
+    MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_TYPE, "text/event-stream");
+    MHD_add_response_header(response, MHD_HTTP_HEADER_CACHE_CONTROL, "no-cache");
+    MHD_add_response_header(response, "X-Accel-Buffering", "no");
+    enum MHD_Result ret = MHD_queue_response(connection, MHD_HTTP_OK, response);
+    MHD_destroy_response(response); // results_stream_free runs when the connection is done with it
+    return ret;
+}
+
+int start_results_stream() {
+    if (pthread_create(&results_broadcaster, NULL, results_broadcaster_main, NULL) != 0) {
+        perror("Failed to start results broadcaster");
+        return 0;
+    }
+    results_broadcaster_started = 1;
+    return 1;
+}
+
+// Ends every open stream. Must run before MHD_stop_daemon, which cannot
+// close connections that are still suspended.
+void stop_results_stream() {
+    pthread_mutex_lock(&results_stream_mutex);
+    results_stream_stopping = 1;
+    pthread_cond_signal(&results_changed_cond);
+    wake_results_watchers(0);
+    pthread_mutex_unlock(&results_stream_mutex);
+    if (results_broadcaster_started) {
+        pthread_join(results_broadcaster, NULL);
+        results_broadcaster_started = 0;
+    }
+}
+
+void free_results_stream() {
+    pthread_mutex_lock(&results_stream_mutex);
+    release_results_snapshot(current_results);
+    current_results = NULL;
+    pthread_mutex_unlock(&results_stream_mutex);
+}
+
+
+// --- Admission Control ---
+// Runs before a request's form state is allocated or its body read. Each
+// client address gets a token bucket, vote submissions in flight are capped,
+// and dashboard renders have a smaller cap that also closes once votes start
+// to back up, so voters keep priority. Shared cached pages and photos cost almost nothing
+// to serve and are only rate limited. Anything turned away gets an immediate
+// 429 or 503 with Retry-After instead of queueing behind the backlog.
+#define DEFAULT_CLIENT_RATE 20          // Requests per second per address (0 = no limit)
+#define CLIENT_BURST_SECONDS 3          // Bucket size, in seconds of rate
+#define CLIENT_BUCKET_SLOTS 16384       // Power of two; colliding addresses take over a slot
+#define CLIENT_BUCKET_STRIPES 64
+#define DEFAULT_MAX_PENDING_VOTES 512
+#define DEFAULT_MAX_ACTIVE_RENDERS 32
+#define DEFAULT_MAX_CONNECTIONS 4096
+#define DEFAULT_CONNECTION_TIMEOUT_S 30
+
+// ADMIT_CONTROL is for admin actions that change the election (starting or
+// stopping it, adding a candidate). They are rare, cheap and answered with a
+// redirect or JSON rather than a page, and must still get through while
+// votes are backing up, so they are never shed; the rate limit still applies.
+enum admission_class { ADMIT_NONE, ADMIT_VOTE, ADMIT_RENDER, ADMIT_CONTROL };
+
+typedef struct {
+    unsigned char addr[16];
+    int in_use;
+    double tokens;
+    unsigned long long refilled_ns;
+} ClientBucket;
+
+long client_rate = DEFAULT_CLIENT_RATE;
+long max_pending_votes = DEFAULT_MAX_PENDING_VOTES;
+long max_active_renders = DEFAULT_MAX_ACTIVE_RENDERS;
+static ClientBucket client_buckets[CLIENT_BUCKET_SLOTS];
+static pthread_mutex_t client_bucket_locks[CLIENT_BUCKET_STRIPES];
+static pthread_once_t client_buckets_once = PTHREAD_ONCE_INIT;
+static long votes_in_flight = 0;
+static long renders_in_flight = 0;
+
+static void init_client_bucket_locks() {
+    for (int i = 0; i < CLIENT_BUCKET_STRIPES; i++) pthread_mutex_init(&client_bucket_locks[i], NULL);
+}
+
+// Copies the client's address into key; IPv6 clients are keyed by their /64,
+// which is what one subscriber usually gets. Returns 0 if unknown.
+static int client_address_key(struct MHD_Connection *connection, unsigned char key[16]) {
+    const union MHD_ConnectionInfo *info = MHD_get_connection_info(connection, MHD_CONNECTION_INFO_CLIENT_ADDRESS);
+    if (info == NULL || info->client_addr == NULL) return 0;
+    memset(key, 0, 16);
+    if (info->client_addr->sa_family == AF_INET) {
+        memcpy(key, &((const struct sockaddr_in *)info->client_addr)->sin_addr, 4);
+        return 1;
+    }
+    if (info->client_addr->sa_family == AF_INET6) {
+        memcpy(key, &((const struct sockaddr_in6 *)info->client_addr)->sin6_addr, 8);
+        key[15] = 6; // Keeps ::/64 prefixes apart from IPv4 addresses
+        return 1;
+    }
+    return 0;
+}
+
+// Takes a token from the client's bucket. Returns 0 when it is allowed,
+// otherwise the seconds until the next token.
+static int take_client_token(struct MHD_Connection *connection) {
+    long rate = client_rate;
+    unsigned char key[16];
+    if (rate <= 0 || !client_address_key(connection, key)) return 0;
+    pthread_once(&client_buckets_once, init_client_bucket_locks);
+
+    size_t slot = (size_t)hash_bytes((const char *)key, sizeof(key)) & (CLIENT_BUCKET_SLOTS - 1);
+    pthread_mutex_t *lock = &client_bucket_locks[slot % CLIENT_BUCKET_STRIPES];
+    double burst = (double)rate * CLIENT_BURST_SECONDS;
+    unsigned long long now = monotonic_ns();
+    int wait_s = 0;
+
+    pthread_mutex_lock(lock);
+    ClientBucket *bucket = &client_buckets[slot];
+    if (!bucket->in_use || memcmp(bucket->addr, key, sizeof(key)) != 0) {
+        memcpy(bucket->addr, key, sizeof(key));
+        bucket->in_use = 1;
+        bucket->tokens = burst;
+    } else {
+        bucket->tokens += (double)(now - bucket->refilled_ns) / 1e9 * (double)rate;
+        if (bucket->tokens > burst) bucket->tokens = burst;
+    }
+    bucket->refilled_ns = now;
+    if (bucket->tokens >= 1.0) {
+        bucket->tokens -= 1.0;
+    } else {
+        wait_s = (int)ceil((1.0 - bucket->tokens) / (double)rate);
+        if (wait_s < 1) wait_s = 1;
+    }
+    pthread_mutex_unlock(lock);
+    return wait_s;
+}
+
+// Reserves a place for the request in its class. Returns 1 if admitted.
+static int reserve_admission(enum admission_class cls, int *shed_reason) {
+    if (cls == ADMIT_VOTE) {
+        if (__atomic_add_fetch(&votes_in_flight, 1, __ATOMIC_RELAXED) <= max_pending_votes) return 1;
+        __atomic_sub_fetch(&votes_in_flight, 1, __ATOMIC_RELAXED);
+        *shed_reason = SHED_VOTES_SATURATED;
+        return 0;
+    }
+    if (cls == ADMIT_RENDER) {
+        // Dashboards wait once a quarter of the vote queue is in use
+        if (__atomic_load_n(&votes_in_flight, __ATOMIC_RELAXED) < (max_pending_votes + 3) / 4) {
+            if (__atomic_add_fetch(&renders_in_flight, 1, __ATOMIC_RELAXED) <= max_active_renders) return 1;
+            __atomic_sub_fetch(&renders_in_flight, 1, __ATOMIC_RELAXED);
+        }
+        *shed_reason = SHED_RENDERS_SATURATED;
+        return 0;
+    }
+    return 1;
+}
+
+static void release_admission(enum admission_class cls) {
+    if (cls == ADMIT_VOTE) __atomic_sub_fetch(&votes_in_flight, 1, __ATOMIC_RELAXED);
+    else if (cls == ADMIT_RENDER) __atomic_sub_fetch(&renders_in_flight, 1, __ATOMIC_RELAXED);
+}
+
+static enum MHD_Result queue_shed_response(struct MHD_Connection *connection, int shed_reason, int retry_after_s) {
+    static const char busy_page[] = "<html><body><h1>Server Busy</h1><p>Too many requests right now. Please try again in a moment.</p></body></html>";
+    METRIC_ADD(requests_shed[shed_reason], 1);
+    struct MHD_Response *response = MHD_create_response_from_buffer(strlen(busy_page), (void *)busy_page, MHD_RESPMEM_PERSISTENT);
+    if (response == NULL) return MHD_NO;
+    char retry_after[16];
+    snprintf(retry_after, sizeof(retry_after), "%d", retry_after_s);
+    MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_TYPE, "text/html");
+    MHD_add_response_header(response, MHD_HTTP_HEADER_RETRY_AFTER, retry_after);
+    MHD_add_response_header(response, MHD_HTTP_HEADER_CONNECTION, "close"); // Do not read an unwanted upload
+    unsigned int status = (shed_reason == SHED_RATE_LIMITED) ? MHD_HTTP_TOO_MANY_REQUESTS : MHD_HTTP_SERVICE_UNAVAILABLE;
+    enum MHD_Result ret = MHD_queue_response(connection, status, response);
+    MHD_destroy_response(response);
+    return ret;
+}
+
+
+// --- Connection State Pool ---
+// Request state is recycled through per-thread free lists instead of being
+// calloc'd and freed for every request. A request only takes the small
+// connection_info_struct; the ~1 KB post_form is attached when it turns out
+// to be a POST. MHD completes a request on the thread that started it, so
+// the lists need no locking, and each is capped so memory from a burst is
+// handed back to malloc afterwards.
+#define CONNECTION_POOL_MAX_FREE 1024
+#define POST_FORM_POOL_MAX_FREE 64
+
+static _Thread_local struct connection_info_struct *free_connection_infos = NULL;
+static _Thread_local int num_free_connection_infos = 0;
+static _Thread_local struct post_form *free_post_forms = NULL;
+static _Thread_local int num_free_post_forms = 0;
+
+static struct connection_info_struct *acquire_connection_info() {
+    struct connection_info_struct *con_info = free_connection_infos;
+    if (con_info == NULL) return calloc(1, sizeof(struct connection_info_struct));
+    free_connection_infos = con_info->next_free;
+    num_free_connection_infos--;
+    memset(con_info, 0, sizeof(*con_info));
+    return con_info;
+}
+
+static struct post_form *acquire_post_form() {
+    struct post_form *form = free_post_forms;
+    if (form == NULL) return calloc(1, sizeof(struct post_form));
+    free_post_forms = form->next_free;
+    num_free_post_forms--;
+    memset(form, 0, sizeof(*form));
+    return form;
+}
+
+static void release_post_form(struct post_form *form) {
+    if (form == NULL) return;
+    photo_upload_free(form->photo_upload);
+    voter_import_free(form->voter_import); // Rows of an aborted import that were not flushed are dropped
+    if (num_free_post_forms >= POST_FORM_POOL_MAX_FREE) {
+        free(form);
+        return;
+    }
+    form->next_free = free_post_forms;
+    free_post_forms = form;
+    num_free_post_forms++;
+}
+
+// Returns the request state, and its form if any, to this thread's pool.
+static void release_connection_info(struct connection_info_struct *con_info) {
+    release_post_form(con_info->form);
+    if (num_free_connection_infos >= CONNECTION_POOL_MAX_FREE) {
+        free(con_info);
+        return;
+    }
+    con_info->next_free = free_connection_infos;
+    free_connection_infos = con_info;
+    num_free_connection_infos++;
+}
+
+
+// --- Form Schemas ---
+// Each POST route declares the fields it accepts and how large its body may
+// be. iterate_post maps a field name to its slot with a switch on length and
+// one confirming strcmp, appends through a per-field cursor, and refuses
+// unknown or oversize fields as soon as they appear. A Content-Length over
+// the route's limit is refused before any of the body is read.
+#define FORM_FIELD_BIT(f) (1u << (f))
+#define FORM_TEXT_FIELD(key, member) { key, offsetof(struct post_form, member), sizeof(((struct post_form *)0)->member) - 1 }
+#define FORM_SMALL_BODY 4096
+
+typedef struct {
+    const char *name;
+    size_t offset;   // Of the char array in struct post_form
+    size_t max_len;  // 0 for file parts, which are streamed elsewhere
+} FormFieldSpec;
+
+static const FormFieldSpec form_field_specs[NUM_FORM_FIELDS] = {
+    [FIELD_AADHAR] = FORM_TEXT_FIELD("aadhar", aadhar),
+    [FIELD_NAME] = FORM_TEXT_FIELD("name", name),
+    [FIELD_CANDIDATE] = FORM_TEXT_FIELD("candidate", candidate_str),
+    [FIELD_PASSWORD] = FORM_TEXT_FIELD("password", password),
+    [FIELD_ADD_ID] = FORM_TEXT_FIELD("add_id", add_id),
+    [FIELD_ADD_NAME] = FORM_TEXT_FIELD("add_name", add_name),
+    [FIELD_ADD_PARTY] = FORM_TEXT_FIELD("add_party", add_party),
+    [FIELD_ADD_VOTER_AADHAR] = FORM_TEXT_FIELD("add_voter_aadhar", add_voter_aadhar),
+    [FIELD_ADD_VOTER_NAME] = FORM_TEXT_FIELD("add_voter_name", add_voter_name),
+    [FIELD_ELECTION_NAME] = FORM_TEXT_FIELD("election_name", election_name),
+    [FIELD_IMAGE_FILE] = { "add_image_file", 0, 0 },
+    [FIELD_VOTER_CSV] = { "voter_csv", 0, 0 },
+};
+
+typedef struct FormSchema {
+    unsigned int fields;          // FORM_FIELD_BIT of each accepted field
+    unsigned long long max_body;  // Bytes; 0 = no limit
+} FormSchema;
+
+// Routes left out accept no form fields at all
+static const FormSchema form_schemas[NUM_ROUTES] = {
+    [ROUTE_SUBMIT_VOTE] = { FORM_FIELD_BIT(FIELD_AADHAR) | FORM_FIELD_BIT(FIELD_NAME) | FORM_FIELD_BIT(FIELD_CANDIDATE), FORM_SMALL_BODY },
+    [ROUTE_RESULTS] = { FORM_FIELD_BIT(FIELD_PASSWORD), FORM_SMALL_BODY },
+    [ROUTE_ADD_CANDIDATE] = { FORM_FIELD_BIT(FIELD_PASSWORD) | FORM_FIELD_BIT(FIELD_ADD_ID) | FORM_FIELD_BIT(FIELD_ADD_NAME) |
+                              FORM_FIELD_BIT(FIELD_ADD_PARTY) | FORM_FIELD_BIT(FIELD_IMAGE_FILE), MAX_UPLOAD_SIZE + 64 * 1024 },
+    [ROUTE_ADD_VOTER] = { FORM_FIELD_BIT(FIELD_PASSWORD) | FORM_FIELD_BIT(FIELD_ADD_VOTER_AADHAR) | FORM_FIELD_BIT(FIELD_ADD_VOTER_NAME), FORM_SMALL_BODY },
+    [ROUTE_IMPORT_VOTERS] = { FORM_FIELD_BIT(FIELD_PASSWORD) | FORM_FIELD_BIT(FIELD_VOTER_CSV), 0 }, // Rolls are streamed
+    [ROUTE_START_ELECTION] = { FORM_FIELD_BIT(FIELD_PASSWORD), FORM_SMALL_BODY },
+    [ROUTE_STOP_ELECTION] = { FORM_FIELD_BIT(FIELD_PASSWORD), FORM_SMALL_BODY },
+    [ROUTE_RESET_ELECTION] = { FORM_FIELD_BIT(FIELD_PASSWORD), FORM_SMALL_BODY },
+    [ROUTE_SET_ELECTION_NAME] = { FORM_FIELD_BIT(FIELD_PASSWORD) | FORM_FIELD_BIT(FIELD_ELECTION_NAME), FORM_SMALL_BODY },
+};
+
+// Returns the form_field for key, or -1.
+static int lookup_form_field(const char *key) {
+    int field;
+    switch (strlen(key)) {
+        case 4:  field = FIELD_NAME; break;
+        case 6:  field = (key[1] == 'a') ? FIELD_AADHAR : FIELD_ADD_ID; break;
+        case 8:  field = (key[0] == 'p') ? FIELD_PASSWORD : FIELD_ADD_NAME; break;
+        case 9:  field = (key[0] == 'c') ? FIELD_CANDIDATE : (key[0] == 'a') ? FIELD_ADD_PARTY : FIELD_VOTER_CSV; break;
+        case 13: field = FIELD_ELECTION_NAME; break;
+        case 14: field = (key[4] == 'i') ? FIELD_IMAGE_FILE : FIELD_ADD_VOTER_NAME; break;
+        case 16: field = FIELD_ADD_VOTER_AADHAR; break;
+        default: return -1;
+    }
+    return (strcmp(key, form_field_specs[field].name) == 0) ? field : -1;
+}
+
+// Counts a chunk of body against the schema. Returns 0 if it is within limits.
+static int form_body_exceeds_limit(struct post_form *form, size_t size) {
+    form->body_bytes += size;
+    return form->schema->max_body != 0 && form->body_bytes > form->schema->max_body;
+}
+
+static enum MHD_Result queue_form_rejection(struct MHD_Connection *connection, unsigned int status) {
+    static const char bad_request_page[] = "<html><body><h1>Bad Request</h1><p>The form contained fields this page does not accept.</p></body></html>";
+    static const char too_large_page[] = "<html><body><h1>Request Too Large</h1><p>The form data is larger than this page accepts.</p></body></html>";
+    const char *body = (status == 413) ? too_large_page : bad_request_page;
+    struct MHD_Response *response = MHD_create_response_from_buffer(strlen(body), (void *)body, MHD_RESPMEM_PERSISTENT);
+    if (response == NULL) return MHD_NO;
+    MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_TYPE, "text/html");
+    MHD_add_response_header(response, MHD_HTTP_HEADER_CONNECTION, "close"); // Leave the rest of the body unread
+    enum MHD_Result ret = MHD_queue_response(connection, status, response);
+    MHD_destroy_response(response);
+    return ret;
+}
+
+
+// --- Admin Sessions ---
+// Logging in, and every redirect back to /admin/dashboard, sets a random
+// session cookie (HttpOnly, SameSite=Strict) that every admin route accepts
+// in place of the password for a while. Pages authorised by a session never
+// carry the password, so neither URLs nor the page source reveal it.
+#define ADMIN_SESSION_COOKIE "admin_session"
+#define ADMIN_SESSION_SLOTS 32 // The oldest session is dropped when all are taken
+#define ADMIN_SESSION_TTL_S 900
+#define ADMIN_SESSION_TOKEN_BYTES 16
+#define ADMIN_SESSION_TOKEN_LEN (ADMIN_SESSION_TOKEN_BYTES * 2)
+
+typedef struct {
+    char token[ADMIN_SESSION_TOKEN_LEN + 1];
+    time_t expires;
+} AdminSession;
+
+static AdminSession admin_sessions[ADMIN_SESSION_SLOTS];
+static pthread_mutex_t admin_sessions_lock = PTHREAD_MUTEX_INITIALIZER; // Leaf lock
+
+static int fill_random(unsigned char *out, size_t len) {
+    #ifdef _WIN32
+        for (size_t i = 0; i < len; i++) {
+            unsigned int r;
+            if (rand_s(&r) != 0) return 0;
+            out[i] = (unsigned char)r;
+        }
+        return 1;
+    #else
+        FILE *file = fopen("/dev/urandom", "rb");
+        if (file == NULL) return 0;
+        size_t got = fread(out, 1, len, file);
+        fclose(file);
+        return got == len;
+    #endif
+}
+
+// Compares every byte so the time taken does not reveal how much of a token matched.
+static int session_tokens_equal(const char *a, const char *b) {
+    unsigned char diff = 0;
+    for (int i = 0; i < ADMIN_SESSION_TOKEN_LEN; i++) diff |= (unsigned char)(a[i] ^ b[i]);
+    return diff == 0;
+}
+
+static int request_has_admin_session(struct MHD_Connection *connection) {
+    const char *token = MHD_lookup_connection_value(connection, MHD_COOKIE_KIND, ADMIN_SESSION_COOKIE);
+    if (token == NULL || strlen(token) != ADMIN_SESSION_TOKEN_LEN) return 0;
+    time_t now = time(NULL);
+    int found = 0;
+    pthread_mutex_lock(&admin_sessions_lock);
+    for (int i = 0; i < ADMIN_SESSION_SLOTS; i++) {
+        if (admin_sessions[i].expires > now && session_tokens_equal(admin_sessions[i].token, token)) found = 1;
+    }
+    pthread_mutex_unlock(&admin_sessions_lock);
+    return found;
+}
 
-        "</div></div>",
-        svg_gauge_chart,
-        svg_doughnut_chart,
-        election_control_html,
-        election_settings_form,
-        total_votes, 
-        svg_bar_chart, 
-        winner_text, 
-        add_candidate_form_with_pass,
-        add_voter_form,
-        voter_list_html
-    );
+// Starts a session and writes its token to out. Returns 0 if the system
+// could not supply random bytes.
+static int start_admin_session(char out[ADMIN_SESSION_TOKEN_LEN + 1]) {
+    unsigned char raw[ADMIN_SESSION_TOKEN_BYTES];
+    if (!fill_random(raw, sizeof(raw))) return 0;
+    for (int i = 0; i < ADMIN_SESSION_TOKEN_BYTES; i++) snprintf(out + 2 * i, 3, "%02x", raw[i]);
+
+    pthread_mutex_lock(&admin_sessions_lock);
+    int slot = 0;
+    for (int i = 1; i < ADMIN_SESSION_SLOTS; i++) {
+        if (admin_sessions[i].expires < admin_sessions[slot].expires) slot = i;
+    }
+    memcpy(admin_sessions[slot].token, out, ADMIN_SESSION_TOKEN_LEN + 1);
+    admin_sessions[slot].expires = time(NULL) + ADMIN_SESSION_TTL_S;
+    pthread_mutex_unlock(&admin_sessions_lock);
+    return 1;
+}
+
+// set_cookie may be NULL.
+static enum MHD_Result send_redirect(struct MHD_Connection *connection, const char *location, const char *set_cookie) {
+    struct MHD_Response *response = MHD_create_response_from_buffer(0, NULL, MHD_RESPMEM_PERSISTENT);
+    if (response == NULL) return MHD_NO;
+    MHD_add_response_header(response, MHD_HTTP_HEADER_LOCATION, location);
+    MHD_add_response_header(response, MHD_HTTP_HEADER_CACHE_CONTROL, "no-store");
+    if (set_cookie != NULL) MHD_add_response_header(response, MHD_HTTP_HEADER_SET_COOKIE, set_cookie);
+    enum MHD_Result ret = MHD_queue_response(connection, MHD_HTTP_SEE_OTHER, response);
+    MHD_destroy_response(response);
+    return ret;
+}
+
+// Redirects to location, first starting a session unless the request
+// already has one. Returns 0 with nothing queued when no session could be
+// started, so the caller can answer directly instead.
+static int redirect_with_admin_session(struct MHD_Connection *connection, const char *location, enum MHD_Result *ret) {
+    if (request_has_admin_session(connection)) {
+        *ret = send_redirect(connection, location, NULL);
+        return 1;
+    }
+    char token[ADMIN_SESSION_TOKEN_LEN + 1];
+    if (!start_admin_session(token)) return 0;
+    char cookie[160];
+    snprintf(cookie, sizeof(cookie), ADMIN_SESSION_COOKIE "=%s; Path=/; Max-Age=%d; HttpOnly; SameSite=Strict",
+             token, ADMIN_SESSION_TTL_S);
+    *ret = send_redirect(connection, location, cookie);
+    return 1;
+}
 
-    return generate_html_shell("Admin Dashboard", body, "Admin", flash_message);
+// An admin form is authorised by its password field or by the session
+// cookie the request arrived with.
+static int admin_form_authorised(const struct post_form *form) {
+    return form->admin_session || strcmp(form->password, ADMIN_PASS) == 0;
 }
 
 
 // --- MHD Handlers ---
-const char *get_mime_type(const char *filename) {
-    if (strstr(filename, ".css")) return "text/css";
-    if (strstr(filename, ".js")) return "application/javascript";
-    if (strstr(filename, ".jpg")) return "image/jpeg";
-    if (strstr(filename, ".jpeg")) return "image/jpeg";
-    if (strstr(filename, ".png")) return "image/png";
-    if (strstr(filename, ".gif")) return "image/gif";
-    if (strstr(filename, ".svg")) return "image/svg+xml";
-    if (strstr(filename, ".ico")) return "image/x-icon";
-    return "application/octet-stream";
-} 
+// /submit_vote connections suspended on a ballot, so shutdown can wait for
+// each to be resumed; MHD_stop_daemon cannot close a suspended connection.
+// Once parking is closed, votes still arriving on open connections are
+// recorded synchronously instead.
+static long parked_ballots = 0;
+static int ballot_parking_closed = 0;
 
-static enum MHD_Result serve_static_file(struct MHD_Connection *connection, const char *url) {
-    char filepath[1024];
-    if (strstr(url, "..")) {
-        return MHD_NO;
-    }
-    snprintf(filepath, sizeof(filepath), "%s%s", STATIC_DIR, url);
+// Ledger writer callback for a suspended /submit_vote connection.
+static void resume_ballot_connection(struct ballot_waiter *waiter) {
+    MHD_resume_connection((struct MHD_Connection *)waiter->cls);
+    __atomic_sub_fetch(&parked_ballots, 1, __ATOMIC_SEQ_CST);
+}
 
-    struct stat st;
-    if (stat(filepath, &st) != 0) {
-        return MHD_NO;
+// Stops parking new ballots and waits until every parked one has settled and
+// resumed its connection. The ledger writers are still running, so each
+// shard's pending and in-flight batches drain on their own. Run after
+// MHD_quiesce_daemon and before MHD_stop_daemon.
+static void drain_parked_ballots() {
+    __atomic_store_n(&ballot_parking_closed, 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&parked_ballots, __ATOMIC_SEQ_CST) > 0) {
+        usleep(1000);
     }
+}
 
-    #ifdef _WIN32
-        int fd = _open(filepath, _O_RDONLY | _O_BINARY);
-    #else
-        int fd = open(filepath, O_RDONLY);
-    #endif
-    
-    if (fd == -1) {
-        return MHD_NO;
+static void generate_ballot_result_page(PageBuffer *page, enum ballot_result result) {
+    if (result == BALLOT_RECORDED) {
+        generate_message_page(page, "Success!", "Your vote has been successfully recorded.", 1);
+    } else if (result == BALLOT_ALREADY_VOTED) {
+        METRIC_ADD(ballots_rejected[REJECT_ALREADY_VOTED], 1);
+        generate_message_page(page, "Already Voted", "This Aadhar number has already been used to cast a vote.", 0);
+    } else {
+        METRIC_ADD(ballots_rejected[REJECT_WRITE_FAILED], 1);
+        generate_message_page(page, "Vote Not Saved", "Your vote could not be recorded. Please try again.", 0);
     }
+}
 
-    struct MHD_Response *response = MHD_create_response_from_fd(st.st_size, fd);
-    if (NULL == response) {
-        #ifdef _WIN32
-            _close(fd);
-        #else
-            close(fd);
-        #endif
-        return MHD_NO;
+// GET endpoints for scripts and dashboards take the admin password as
+// ?key=... or as an "Authorization: Bearer ..." header.
+static int request_has_admin_key(struct MHD_Connection *connection) {
+    const char *key = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "key");
+    if (key == NULL) {
+        const char *auth = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, MHD_HTTP_HEADER_AUTHORIZATION);
+        if (auth != NULL && strncasecmp(auth, "Bearer ", 7) == 0) key = auth + 7;
     }
+    return key != NULL && strcmp(key, ADMIN_PASS) == 0;
+}
 
-    const char *mime_type = get_mime_type(url);
-    MHD_add_response_header(response, "Content-Type", mime_type);
-    enum MHD_Result ret = MHD_queue_response(connection, MHD_HTTP_OK, response);
-    MHD_destroy_response(response);
+// Serves GET /images/<file> from the image cache, answering conditional
+// requests with a 304. Returns MHD_NO if there is no such image.
+static enum MHD_Result serve_image(struct MHD_Connection *connection, const char *url) {
+    CachedImage *image = lock_cached_image(url + strlen("/" UPLOAD_DIR "/"));
+    if (image == NULL) return MHD_NO;
+
+    const char *v = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "v");
+    int immutable = v != NULL && strcmp(v, image->version) == 0;
+    const char *since = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, MHD_HTTP_HEADER_IF_MODIFIED_SINCE);
+    int not_modified = etag_matches(connection, image->etag)
+                    || (since != NULL && MHD_lookup_connection_value(connection, MHD_HEADER_KIND, MHD_HTTP_HEADER_IF_NONE_MATCH) == NULL
+                        && strcmp(since, image->last_modified) == 0);
+    enum MHD_Result ret;
+    if (not_modified) {
+        ret = MHD_queue_response(connection, MHD_HTTP_NOT_MODIFIED, immutable ? image->immutable_not_modified : image->revalidate_not_modified);
+    } else {
+        ret = MHD_queue_response(connection, MHD_HTTP_OK, immutable ? image->immutable : image->revalidate);
+    }
+    pthread_rwlock_unlock(&image_cache_lock);
     return ret;
 }
 
@@ -1094,71 +5085,67 @@ static enum MHD_Result iterate_post(void *coninfo_cls, enum MHD_ValueKind kind,
                                   const char *filename, const char *content_type,
                                   const char *transfer_encoding, const char *data, uint64_t off, size_t size) {
     
-    struct connection_info_struct *con_info = coninfo_cls;
+    struct post_form *form = coninfo_cls;
     if (key == NULL) return MHD_YES;
 
+    // Fields the route's schema does not list, or of the wrong kind, stop the body here
+    int field = lookup_form_field(key);
+    if (field == -1 || !(form->schema->fields & FORM_FIELD_BIT(field)) ||
+        (filename != NULL) != (form_field_specs[field].max_len == 0)) {
+        form->rejected = 400;
+        return MHD_NO;
+    }
+
     if (filename == NULL) {
-        if (size > 0) {
-            if (0 == strcmp(key, "aadhar")) { strncat(con_info->aadhar, data, 19 - strlen(con_info->aadhar)); }
-            if (0 == strcmp(key, "name")) { strncat(con_info->name, data, 99 - strlen(con_info->name)); }
-            if (0 == strcmp(key, "candidate")) { strncat(con_info->candidate_str, data, 9 - strlen(con_info->candidate_str)); }
-            if (0 == strcmp(key, "password")) { strncat(con_info->password, data, 49 - strlen(con_info->password)); }
-            if (0 == strcmp(key, "add_id")) { strncat(con_info->add_id, data, 9 - strlen(con_info->add_id)); }
-            if (0 == strcmp(key, "add_name")) { strncat(con_info->add_name, data, 99 - strlen(con_info->add_name)); }
-            if (0 == strcmp(key, "add_party")) { strncat(con_info->add_party, data, 99 - strlen(con_info->add_party)); } // NEW
-            if (0 == strcmp(key, "add_voter_aadhar")) { strncat(con_info->add_voter_aadhar, data, 19 - strlen(con_info->add_voter_aadhar)); }
-            if (0 == strcmp(key, "add_voter_name")) { strncat(con_info->add_voter_name, data, 99 - strlen(con_info->add_voter_name)); }
-            if (0 == strcmp(key, "election_name")) { strncat(con_info->election_name, data, 99 - strlen(con_info->election_name)); }
+        const FormFieldSpec *spec = &form_field_specs[field];
+        size_t len = form->field_len[field];
+        if (size > spec->max_len - len) {
+            form->rejected = 413;
+            return MHD_NO;
+        }
+        char *value = (char *)form + spec->offset;
+        memcpy(value + len, data, size);
+        form->field_len[field] = (unsigned short)(len + size);
+        value[len + size] = '\0';
+        return MHD_YES;
+    }
+
+    if (field == FIELD_VOTER_CSV) {
+        // The form sends the password first, so rows are never read unauthenticated
+        if (!admin_form_authorised(form)) return MHD_NO;
+        if (form->voter_import == NULL) {
+            form->voter_import = voter_import_begin();
+            if (form->voter_import == NULL) return MHD_NO;
         }
+        if (size > 0 && !voter_import_feed(form->voter_import, data, size)) return MHD_NO;
         return MHD_YES;
     }
 
-    if (0 == strcmp(key, "add_image_file")) {
+    if (field == FIELD_IMAGE_FILE) {
+        // The form sends the password first, so nothing is written to disk unauthenticated
+        if (!admin_form_authorised(form)) return MHD_NO;
         if (off == 0) {
-            if (con_info->upload_file_handle != NULL) {
-                fclose(con_info->upload_file_handle);
-                con_info->upload_file_handle = NULL;
-            }
-            if (!content_type || (strcmp(content_type, "image/jpeg") != 0 && strcmp(content_type, "image/png") != 0)) {
-                con_info->error_flag = 2;
+            // A repeated file part replaces the earlier one
+            photo_upload_free(form->photo_upload);
+            strncpy(form->original_filename, filename, 255);
+            form->photo_upload = photo_upload_begin();
+            if (form->photo_upload == NULL) {
+                form->error_flag = 3;
                 return MHD_NO;
             }
-            
-            strncpy(con_info->original_filename, filename, 255);
-            con_info->upload_file_handle = fopen(TEMP_UPLOAD_FILE, "wb");
-            if (con_info->upload_file_handle == NULL) {
-                con_info->error_flag = 3;
-                return MHD_NO;
-            }
-            con_info->total_upload_size = 0;
-            con_info->error_flag = 4;
+            form->error_flag = 4;
         }
+        if (form->photo_upload == NULL) return MHD_NO;
 
         if (size > 0) {
-            con_info->total_upload_size += size;
-            if (con_info->total_upload_size > MAX_UPLOAD_SIZE) {
-                con_info->error_flag = 1;
-                fclose(con_info->upload_file_handle);
-                con_info->upload_file_handle = NULL;
-                remove(TEMP_UPLOAD_FILE);
-                return MHD_NO;
-            }
-            
-            if (fwrite(data, 1, size, con_info->upload_file_handle) != size) {
-                con_info->error_flag = 3;
-                fclose(con_info->upload_file_handle);
-                con_info->upload_file_handle = NULL;
-                remove(TEMP_UPLOAD_FILE);
+            int error = photo_upload_feed(form->photo_upload, data, size);
+            if (error != 0) {
+                form->error_flag = error;
+                photo_upload_free(form->photo_upload);
+                form->photo_upload = NULL;
                 return MHD_NO;
             }
-            con_info->error_flag = 0;
-        }
-
-        if (size == 0) {
-            if (con_info->upload_file_handle != NULL) {
-                fclose(con_info->upload_file_handle);
-                con_info->upload_file_handle = NULL;
-            }
+            form->error_flag = 0;
         }
     }
 
@@ -1169,232 +5156,654 @@ static void request_completed(void *cls, struct MHD_Connection *connection,
                               void **con_cls, enum MHD_RequestTerminationCode toe) {
     struct connection_info_struct *con_info = *con_cls;
     if (NULL == con_info) return;
+    observe_request(con_info->route, monotonic_ns() - con_info->started_ns);
+    release_admission(con_info->admission);
     if (con_info->postprocessor) {
         MHD_destroy_post_processor(con_info->postprocessor);
     }
-    if (con_info->upload_file_handle != NULL) {
-        fclose(con_info->upload_file_handle);
-        remove(TEMP_UPLOAD_FILE);
+    if (con_info->ballot != NULL) {
+        // Already settled: the connection stays suspended until on_done resumes it
+        wait_for_ballot(con_info->ballot);
+        free(con_info->ballot);
     }
-    free(con_info);
+    release_connection_info(con_info);
     *con_cls = NULL;
 }
 
-// MODIFIED: request_handler now handles add_party
-static enum MHD_Result request_handler(void *cls, struct MHD_Connection *connection,
-                                     const char *url, const char *method,
-                                     const char *version, const char *upload_data,
-                                     size_t *upload_data_size, void **con_cls) {
-    
-    if (NULL == *con_cls) {
-        struct connection_info_struct *con_info;
-        con_info = calloc(1, sizeof(struct connection_info_struct));
-        if (NULL == con_info) return MHD_NO;
-        *con_cls = (void *)con_info;
-        return MHD_YES;
+static void connection_notify(void *cls, struct MHD_Connection *connection,
+                              void **socket_context, enum MHD_ConnectionNotificationCode toe) {
+    if (toe == MHD_CONNECTION_NOTIFY_STARTED) {
+        METRIC_ADD(connections_opened, 1);
+    } else if (toe == MHD_CONNECTION_NOTIFY_CLOSED) {
+        METRIC_ADD(connections_closed, 1);
     }
+}
 
-    struct connection_info_struct *con_info = *con_cls;
-    const char *page = "<html><body>Internal Server Error</body></html>";
-    int status_code = 500;
+// --- Router ---
+// Routes are looked up by path in a small hash table keyed off route_labels,
+// which also names them in /metrics. Each route's row lists the methods it
+// answers (GET routes also answer HEAD), the admin check it needs, its
+// admission class and its handler. The dispatcher applies these in turn:
+// rate limit, 404/405, admission, POST body parsing against the route's
+// form schema, authentication, then the handler.
+#define ROUTE_HASH_SLOTS 64 // Power of two, comfortably above NUM_ROUTES
+
+enum route_method { METHOD_GET = 1, METHOD_POST = 2 };
+enum route_auth {
+    AUTH_NONE,
+    AUTH_ADMIN_KEY,      // ?key=, Bearer or the admin session cookie; 403 page otherwise
+    AUTH_ADMIN_KEY_JSON, // Same, with a 401 JSON error
+    AUTH_ADMIN_PASSWORD  // The form's password field or the session cookie; 403 page otherwise
+};
+
+typedef struct RequestContext {
+    struct MHD_Connection *connection;
+    struct connection_info_struct *con_info;
+    struct post_form *form; // POST routes only, with line breaks trimmed from the fields
+    const char *url;
+} RequestContext;
+
+typedef enum MHD_Result (*RouteHandler)(RequestContext *ctx);
+
+typedef struct {
+    unsigned int methods;
+    enum route_auth auth;
+    enum admission_class admission;
+    int rate_limited;
+    RouteHandler handler;
+} Route;
+
+static signed char route_hash_slots[ROUTE_HASH_SLOTS];
+static pthread_once_t route_hash_once = PTHREAD_ONCE_INIT;
+
+static void init_route_hash() {
+    memset(route_hash_slots, -1, sizeof(route_hash_slots));
+    for (int r = 0; r < ROUTE_OTHER; r++) {
+        if (r == ROUTE_IMAGES) continue; // Matched by prefix
+        size_t slot = (size_t)hash_bytes(route_labels[r], strlen(route_labels[r])) & (ROUTE_HASH_SLOTS - 1);
+        while (route_hash_slots[slot] != -1) slot = (slot + 1) & (ROUTE_HASH_SLOTS - 1);
+        route_hash_slots[slot] = (signed char)r;
+    }
+}
+
+int classify_route(const char *url) {
+    if (strncmp(url, "/images/", 8) == 0) return ROUTE_IMAGES;
+    pthread_once(&route_hash_once, init_route_hash);
+    size_t slot = (size_t)hash_bytes(url, strlen(url)) & (ROUTE_HASH_SLOTS - 1);
+    while (route_hash_slots[slot] != -1) {
+        if (strcmp(url, route_labels[route_hash_slots[slot]]) == 0) return route_hash_slots[slot];
+        slot = (slot + 1) & (ROUTE_HASH_SLOTS - 1);
+    }
+    return ROUTE_OTHER;
+}
+
+// Queues a rendered page, compressing it for the client if worthwhile.
+// Takes ownership of the page's buffer.
+static enum MHD_Result send_page(struct MHD_Connection *connection, PageBuffer *page, unsigned int status_code, const char *content_type) {
     struct MHD_Response *response;
-    const char *flash_message = NULL; 
-
-    if (0 == strcmp(method, "POST")) {
-        if (*upload_data_size != 0) {
-            if (con_info->postprocessor == NULL) {
-                con_info->postprocessor = MHD_create_post_processor(connection, 8192, iterate_post, (void*)con_info);
-                if (NULL == con_info->postprocessor) {
-                    free(con_info);
-                    return MHD_NO;
-                }
-            }
-            if (MHD_post_process(con_info->postprocessor, upload_data, *upload_data_size) != MHD_YES) {
-                // Error already set by iterate_post
-            }
-            *upload_data_size = 0;
-            return MHD_YES;
-        } 
-        else {
-            if (con_info->postprocessor) {
-                MHD_destroy_post_processor(con_info->postprocessor);
-                con_info->postprocessor = NULL;
+    int encoding = ENCODING_IDENTITY;
+    if (page->failed || page->len == 0) {
+        static const char error_page[] = "<html><body>Internal Server Error</body></html>";
+        if (page->failed) status_code = 500;
+        page_free(page);
+        response = MHD_create_response_from_buffer(strlen(error_page), (void*)error_page, MHD_RESPMEM_PERSISTENT);
+    } else {
+        // Per-request pages get a fast compression level; keep the result only if it is smaller
+        if (page->len >= DYNAMIC_PAGE_COMPRESS_MIN) {
+            encoding = negotiate_encoding(connection, supported_encodings());
+            char *compressed = NULL;
+            size_t compressed_len = 0;
+            if (encoding != ENCODING_IDENTITY &&
+                compress_body(encoding, page->data, page->len, COMPRESS_FAST, &compressed, &compressed_len) &&
+                compressed_len < page->len) {
+                page_free(page);
+                page->data = compressed;
+                page->len = compressed_len;
+            } else {
+                free(compressed);
+                encoding = ENCODING_IDENTITY;
             }
-            
-            con_info->aadhar[strcspn(con_info->aadhar, "\r\n")] = 0;
-            con_info->name[strcspn(con_info->name, "\r\n")] = 0;
-            con_info->add_id[strcspn(con_info->add_id, "\r\n")] = 0;
-            con_info->add_name[strcspn(con_info->add_name, "\r\n")] = 0;
-            con_info->add_party[strcspn(con_info->add_party, "\r\n")] = 0; // NEW
-            con_info->add_voter_aadhar[strcspn(con_info->add_voter_aadhar, "\r\n")] = 0;
-            con_info->add_voter_name[strcspn(con_info->add_voter_name, "\r\n")] = 0;
-            con_info->password[strcspn(con_info->password, "\r\n")] = 0;
-            con_info->election_name[strcspn(con_info->election_name, "\r\n")] = 0;
+        }
+        // The builder's buffer becomes the response body; MHD frees it when done
+        response = MHD_create_response_from_buffer(page->len, page->data, MHD_RESPMEM_MUST_FREE);
+        if (response == NULL) page_free(page);
+        page->data = NULL;
+        page->len = page->cap = 0;
+    }
+    if (response == NULL) return MHD_NO;
+    MHD_add_response_header(response, "Content-Type", content_type);
+    MHD_add_response_header(response, MHD_HTTP_HEADER_VARY, "Accept-Encoding");
+    if (encoding != ENCODING_IDENTITY) {
+        MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_ENCODING, encoding_names[encoding]);
+    }
+    enum MHD_Result ret = MHD_queue_response(connection, status_code, response);
+    MHD_destroy_response(response);
+    return ret;
+}
 
-            
-            if (0 == strcmp(url, "/submit_vote")) {
-                if (strcmp(ELECTION_STATE, "LIVE") != 0) {
-                    page = generate_message_page("Voting Not Active", "Voting is not currently open.", 0);
-                }
-                else if (!is_voter_registered(con_info->aadhar, con_info->name)) {
-                    page = generate_message_page("Validation Failed", "Your Aadhar and Name do not match our records.", 0);
-                } else if (has_voted(con_info->aadhar)) {
-                    page = generate_message_page("Already Voted", "This Aadhar number has already been used to cast a vote.", 0);
-                } else if (con_info->candidate_str[0] == '\0') {
-                    page = generate_message_page("No Selection", "You did not select a candidate.", 0);
-                } else {
-                    record_vote(atoi(con_info->candidate_str));
-                    record_voter_turnout(con_info->aadhar);
-                    page = generate_message_page("Success!", "Your vote has been successfully recorded.", 1);
-                }
-            } else if (0 == strcmp(url, "/results")) {
-                if (strcmp(con_info->password, ADMIN_PASS) == 0) {
-                    page = generate_admin_dashboard_page(con_info->password, NULL); 
-                } else {
-                    page = generate_message_page("Access Denied", "The password you entered is incorrect.", 0);
-                }
-            } 
-            else if (0 == strcmp(url, "/add_candidate")) {
-                if (strcmp(con_info->password, ADMIN_PASS) == 0) {
-                    // MODIFIED: Check for party name
-                    if (con_info->add_id[0] == '\0' || con_info->add_name[0] == '\0' || con_info->add_party[0] == '\0') {
-                         flash_message = "Error: Candidate ID, Name, and Party are required.";
-                         con_info->error_flag = 5;
-                         remove(TEMP_UPLOAD_FILE);
-                    } else if (con_info->error_flag == 1) {
-                        flash_message = "Error: File is larger than 5MB.";
-                    } else if (con_info->error_flag == 2) {
-                        flash_message = "Error: Only .jpg or .png images are allowed.";
-                    } else if (con_info->error_flag == 3) {
-                        flash_message = "Error: Server failed to write file.";
-                    } else if (con_info->error_flag == 4 || con_info->original_filename[0] == '\0') {
-                        flash_message = "Error: No file was uploaded.";
-                    } else {
-                        const char *ext = strrchr(con_info->original_filename, '.');
-                        if (!ext || (strcmp(ext, ".jpg") != 0 && strcmp(ext, ".png") != 0 && strcmp(ext, ".jpeg") != 0)) {
-                            ext = ".jpg";
-                        }
-                        
-                        char final_filepath[256];
-                        char url_path[256];
-
-                        snprintf(final_filepath, sizeof(final_filepath), "%s/%s%s", UPLOAD_DIR, con_info->add_id, ext);
-                        snprintf(url_path, sizeof(url_path), "/%s/%s%s", UPLOAD_DIR, con_info->add_id, ext);
-                        
-                        if (rename(TEMP_UPLOAD_FILE, final_filepath) == 0) {
-                            // MODIFIED: Pass party name to function
-                            if (add_new_candidate(con_info->add_id, con_info->add_name, con_info->add_party, url_path)) {
-                                load_candidates(); 
-                                flash_message = "Success! Candidate added successfully.";
-                            } else {
-                                flash_message = "Error: Failed to save candidate to file.";
-                            }
-                        } else {
-                            flash_message = "Error: Failed to save file after upload.";
-                            perror("Rename failed");
-                            remove(TEMP_UPLOAD_FILE);
-                        }
-                    }
-                } else {
-                    flash_message = "Error: Invalid password.";
-                    remove(TEMP_UPLOAD_FILE);
-                }
-                page = generate_admin_dashboard_page(con_info->password, flash_message); 
-            }
-            else if (0 == strcmp(url, "/add_voter")) {
-                if (strcmp(con_info->password, ADMIN_PASS) == 0) {
-                    if (con_info->add_voter_aadhar[0] == '\0' || con_info->add_voter_name[0] == '\0') {
-                        flash_message = "Error: Voter Aadhar and Name are required.";
-                    } else {
-                        if (add_new_voter(con_info->add_voter_aadhar, con_info->add_voter_name)) {
-                            flash_message = "Success! Voter added successfully.";
-                        } else {
-                            flash_message = "Error: Failed to save voter to file.";
-                        }
-                    }
-                } else {
-                    flash_message = "Error: Invalid password.";
-                }
-                page = generate_admin_dashboard_page(con_info->password, flash_message);
-            }
-            else if (0 == strcmp(url, "/start_election")) {
-                if (strcmp(con_info->password, ADMIN_PASS) == 0) {
-                    save_election_state("LIVE");
-                    flash_message = "Success! Election is now LIVE.";
-                } else {
-                    flash_message = "Error: Invalid password.";
-                }
-                page = generate_admin_dashboard_page(con_info->password, flash_message);
-            }
-            else if (0 == strcmp(url, "/stop_election")) {
-                if (strcmp(con_info->password, ADMIN_PASS) == 0) {
-                    save_election_state("CLOSED");
-                    flash_message = "Success! Election is now CLOSED.";
-                } else {
-                    flash_message = "Error: Invalid password.";
-                }
-                page = generate_admin_dashboard_page(con_info->password, flash_message);
-            }
-            else if (0 == strcmp(url, "/reset_election")) {
-                if (strcmp(con_info->password, ADMIN_PASS) == 0) {
-                    if (archive_votes_file()) {
-                        save_election_state("PREP");
-                        load_candidates();
-                        flash_message = "Success! Election has been reset.";
-                    } else {
-                        flash_message = "Error: Failed to archive and reset files.";
-                    }
-                } else {
-                    flash_message = "Error: Invalid password.";
-                }
-                page = generate_admin_dashboard_page(con_info->password, flash_message);
-            }
-            else if (0 == strcmp(url, "/set_election_name")) {
-                 if (strcmp(con_info->password, ADMIN_PASS) == 0) {
-                    if (con_info->election_name[0] == '\0') {
-                        flash_message = "Error: Election name cannot be empty.";
-                    } else {
-                        save_election_name(con_info->election_name);
-                        flash_message = "Success! Election name has been set.";
-                    }
-                 } else {
-                    flash_message = "Error: Invalid password.";
-                 }
-                 page = generate_admin_dashboard_page(con_info->password, flash_message);
+static enum MHD_Result send_message_page(struct MHD_Connection *connection, unsigned int status_code,
+                                         const char *title, const char *message) {
+    PageBuffer page = {0};
+    generate_message_page(&page, title, message, 0);
+    return send_page(connection, &page, status_code, "text/html");
+}
+
+// Only a request that sent the password gets it back in the page's forms;
+// one authorised by its session cookie keeps using that.
+static enum MHD_Result send_dashboard(RequestContext *ctx, const char *flash_message) {
+    PageBuffer page = {0};
+    generate_admin_dashboard_page(&page, strcmp(ctx->form->password, ADMIN_PASS) == 0 ? ADMIN_PASS : "", flash_message);
+    return send_page(ctx->connection, &page, 200, "text/html");
+}
+
+// Admin actions answer with a small JSON status when the dashboard script
+// asks for one, naming the panels it should refetch. Plain form posts are
+// redirected to GET /admin/dashboard (authorised by an admin session
+// cookie), which shows the outcome as a flash message, so a reload does not
+// repeat the action.
+#define PANEL_BIT(p) (1u << (p))
+#define REFRESH_VOTER_LIST (1u << NUM_DASHBOARD_PANELS) // The script reloads it from /admin/voters
+
+enum admin_flash {
+    FLASH_CANDIDATE_FIELDS_MISSING, FLASH_PHOTO_TOO_LARGE, FLASH_PHOTO_WRONG_TYPE, FLASH_PHOTO_WRITE_FAILED,
+    FLASH_PHOTO_MISSING, FLASH_PHOTO_SAVE_FAILED, FLASH_CANDIDATE_SAVE_FAILED, FLASH_CANDIDATE_ADDED,
+    FLASH_VOTER_FIELDS_MISSING, FLASH_VOTER_SAVE_FAILED, FLASH_VOTER_ADDED,
+    FLASH_ELECTION_STARTED, FLASH_ELECTION_STOPPED, FLASH_RESET_FAILED, FLASH_ELECTION_RESET,
+    FLASH_NAME_EMPTY, FLASH_NAME_SET, NUM_ADMIN_FLASHES
+};
+
+static const struct {
+    unsigned int status;
+    const char *message;
+} admin_flashes[NUM_ADMIN_FLASHES] = {
+    [FLASH_CANDIDATE_FIELDS_MISSING] = { 400, "Error: Candidate ID, Name, and Party are required." },
+    [FLASH_PHOTO_TOO_LARGE] = { 413, "Error: File is larger than 5MB." },
+    [FLASH_PHOTO_WRONG_TYPE] = { 400, "Error: Only .jpg or .png images are allowed." },
+    [FLASH_PHOTO_WRITE_FAILED] = { 500, "Error: Server failed to write file." },
+    [FLASH_PHOTO_MISSING] = { 400, "Error: No file was uploaded." },
+    [FLASH_PHOTO_SAVE_FAILED] = { 500, "Error: Failed to save file after upload." },
+    [FLASH_CANDIDATE_SAVE_FAILED] = { 500, "Error: Failed to save candidate to file." },
+    [FLASH_CANDIDATE_ADDED] = { 200, "Success! Candidate added successfully." },
+    [FLASH_VOTER_FIELDS_MISSING] = { 400, "Error: Voter Aadhar and Name are required." },
+    [FLASH_VOTER_SAVE_FAILED] = { 500, "Error: Failed to save voter to file." },
+    [FLASH_VOTER_ADDED] = { 200, "Success! Voter added successfully." },
+    [FLASH_ELECTION_STARTED] = { 200, "Success! Election is now LIVE." },
+    [FLASH_ELECTION_STOPPED] = { 200, "Success! Election is now CLOSED." },
+    [FLASH_RESET_FAILED] = { 500, "Error: Failed to archive and reset files." },
+    [FLASH_ELECTION_RESET] = { 200, "Success! Election has been reset." },
+    [FLASH_NAME_EMPTY] = { 400, "Error: Election name cannot be empty." },
+    [FLASH_NAME_SET] = { 200, "Success! Election name has been set." },
+};
+
+static int client_wants_json(struct MHD_Connection *connection) {
+    const char *accept = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, MHD_HTTP_HEADER_ACCEPT);
+    return accept != NULL && strstr(accept, "application/json") != NULL;
+}
+
+// {"ok":...,"message":"...","panels":[...]}; panels are only listed on success.
+static enum MHD_Result send_action_status(struct MHD_Connection *connection, unsigned int status_code,
+                                          const char *message, unsigned int panels) {
+    PageBuffer page = {0};
+    page_appendf(&page, "{\"ok\":%s,\"message\":\"", status_code == 200 ? "true" : "false");
+    page_append_json(&page, message);
+    page_append(&page, "\",\"panels\":[");
+    int listed = 0;
+    for (int p = 0; p < NUM_DASHBOARD_PANELS && status_code == 200; p++) {
+        if (panels & PANEL_BIT(p)) page_appendf(&page, "%s\"%s\"", listed++ ? "," : "", dashboard_panel_names[p]);
+    }
+    if (status_code == 200 && (panels & REFRESH_VOTER_LIST)) page_appendf(&page, "%s\"voters\"", listed ? "," : "");
+    page_append(&page, "]}");
+    return send_page(connection, &page, status_code, "application/json");
+}
+
+static enum MHD_Result finish_admin_action(RequestContext *ctx, enum admin_flash flash, unsigned int panels) {
+    if (client_wants_json(ctx->connection)) {
+        return send_action_status(ctx->connection, admin_flashes[flash].status, admin_flashes[flash].message, panels);
+    }
+    char location[64];
+    snprintf(location, sizeof(location), "/admin/dashboard?flash=%d", (int)flash);
+    enum MHD_Result ret;
+    if (redirect_with_admin_session(ctx->connection, location, &ret)) return ret;
+    return send_dashboard(ctx, admin_flashes[flash].message); // No session, so no redirect
+}
+
+static enum MHD_Result handle_voting_page(RequestContext *ctx) {
+    reload_candidates_if_changed();
+    if (serve_cached_page(ctx->connection, &voting_page_cache) == MHD_YES) return MHD_YES;
+    PageBuffer page = {0};
+    generate_voting_page(&page);
+    return send_page(ctx->connection, &page, 200, "text/html");
+}
+
+static enum MHD_Result handle_admin_login(RequestContext *ctx) {
+    if (serve_cached_page(ctx->connection, &admin_login_cache) == MHD_YES) return MHD_YES;
+    PageBuffer page = {0};
+    generate_admin_login_page(&page);
+    return send_page(ctx->connection, &page, 200, "text/html");
+}
+
+static enum MHD_Result handle_metrics(RequestContext *ctx) {
+    PageBuffer page = {0};
+    generate_metrics_text(&page);
+    return send_page(ctx->connection, &page, 200, "text/plain; version=0.0.4");
+}
+
+static enum MHD_Result handle_results_api(RequestContext *ctx) {
+    if (serve_cached_page(ctx->connection, &results_api_cache) == MHD_YES) return MHD_YES;
+    PageBuffer page = {0};
+    generate_results_json(&page);
+    return send_page(ctx->connection, &page, 200, "application/json");
+}
+
+static enum MHD_Result handle_voter_list(RequestContext *ctx) {
+    struct MHD_Connection *connection = ctx->connection;
+    const char *offset_arg = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "offset");
+    const char *limit_arg = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "limit");
+    const char *voted_arg = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "voted");
+    const char *format_arg = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "format");
+    long offset = offset_arg ? strtol(offset_arg, NULL, 10) : 0;
+    long limit = limit_arg ? strtol(limit_arg, NULL, 10) : VOTER_LIST_PREVIEW_LIMIT;
+    if (offset < 0) offset = 0;
+    if (limit < 1) limit = 1;
+    if (limit > VOTER_LIST_MAX_LIMIT) limit = VOTER_LIST_MAX_LIMIT;
+    int filter = VOTER_FILTER_ALL;
+    if (voted_arg != NULL && strcmp(voted_arg, "yes") == 0) filter = VOTER_FILTER_VOTED;
+    else if (voted_arg != NULL && strcmp(voted_arg, "no") == 0) filter = VOTER_FILTER_NOT_VOTED;
+    int as_json = format_arg != NULL && strcmp(format_arg, "json") == 0;
+    PageBuffer page = {0};
+    generate_voter_page(&page, offset, (int)limit, filter, as_json);
+    return send_page(connection, &page, 200, as_json ? "application/json" : "text/html");
+}
+
+static enum MHD_Result handle_results_stream(RequestContext *ctx) {
+    return serve_results_stream(ctx->connection);
+}
+
+static enum MHD_Result handle_image(RequestContext *ctx) {
+    if (serve_image(ctx->connection, ctx->url) == MHD_YES) return MHD_YES;
+    return send_message_page(ctx->connection, 404, "Not Found", "The requested image does not exist.");
+}
+
+static enum MHD_Result handle_submit_vote(RequestContext *ctx) {
+    struct connection_info_struct *con_info = ctx->con_info;
+    struct post_form *form = ctx->form;
+    PageBuffer page = {0};
+    if (con_info->ballot != NULL) {
+        // Resumed by the ledger writer once the ballot settled
+        generate_ballot_result_page(&page, con_info->ballot->ok ? BALLOT_RECORDED : BALLOT_WRITE_FAILED);
+        return send_page(ctx->connection, &page, 200, "text/html");
+    }
+
+    char election_state[20];
+    copy_election_state(election_state);
+    if (strcmp(election_state, "LIVE") != 0) {
+        METRIC_ADD(ballots_rejected[REJECT_NOT_LIVE], 1);
+        generate_message_page(&page, "Voting Not Active", "Voting is not currently open.", 0);
+    }
+    else if (!is_voter_registered(form->aadhar, form->name)) {
+        METRIC_ADD(ballots_rejected[REJECT_NOT_REGISTERED], 1);
+        generate_message_page(&page, "Validation Failed", "Your Aadhar and Name do not match our records.", 0);
+    } else if (has_voted(form->aadhar)) {
+        METRIC_ADD(ballots_rejected[REJECT_ALREADY_VOTED], 1);
+        generate_message_page(&page, "Already Voted", "This Aadhar number has already been used to cast a vote.", 0);
+    } else if (form->candidate_str[0] == '\0') {
+        METRIC_ADD(ballots_rejected[REJECT_NO_SELECTION], 1);
+        generate_message_page(&page, "No Selection", "You did not select a candidate.", 0);
+    } else {
+        // Parks the connection until the ledger writer has synced the
+        // ballot, so no worker thread sits waiting on the disk
+        enum ballot_result result = BALLOT_WRITE_FAILED;
+        // Counted before the check, so shutdown either sees this ballot or we see it closing
+        __atomic_add_fetch(&parked_ballots, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&ballot_parking_closed, __ATOMIC_SEQ_CST)) {
+            __atomic_sub_fetch(&parked_ballots, 1, __ATOMIC_SEQ_CST);
+            result = record_ballot(form->aadhar, atoi(form->candidate_str));
+        } else {
+            con_info->ballot = calloc(1, sizeof(struct ballot_waiter));
+            if (con_info->ballot != NULL) {
+                con_info->ballot->on_done = resume_ballot_connection;
+                con_info->ballot->cls = ctx->connection;
+                MHD_suspend_connection(ctx->connection);
+                result = submit_ballot(form->aadhar, atoi(form->candidate_str), con_info->ballot);
+                if (result == BALLOT_PENDING) return MHD_YES;
+                MHD_resume_connection(ctx->connection);
+                free(con_info->ballot);
+                con_info->ballot = NULL;
             }
+            __atomic_sub_fetch(&parked_ballots, 1, __ATOMIC_SEQ_CST);
+        }
+        generate_ballot_result_page(&page, result);
+    }
+    return send_page(ctx->connection, &page, 200, "text/html");
+}
+
+// The login form: starts a session and sends the browser to the dashboard.
+static enum MHD_Result handle_dashboard(RequestContext *ctx) {
+    enum MHD_Result ret;
+    if (redirect_with_admin_session(ctx->connection, "/admin/dashboard", &ret)) return ret;
+    return send_dashboard(ctx, NULL);
+}
+
+// Where plain form posts land after an action; ?flash= names its outcome.
+// Reached with ?key= or Bearer instead of a session, it starts one and
+// redirects to itself, so the page is always authorised by the cookie.
+static enum MHD_Result handle_admin_dashboard(RequestContext *ctx) {
+    const char *flash_arg = MHD_lookup_connection_value(ctx->connection, MHD_GET_ARGUMENT_KIND, "flash");
+    int flash = flash_arg ? atoi(flash_arg) : -1;
+    if (flash < 0 || flash >= NUM_ADMIN_FLASHES) flash = -1;
+    int has_session = request_has_admin_session(ctx->connection);
+    if (!has_session) {
+        char location[64];
+        if (flash >= 0) snprintf(location, sizeof(location), "/admin/dashboard?flash=%d", flash);
+        else snprintf(location, sizeof(location), "/admin/dashboard");
+        enum MHD_Result ret;
+        if (redirect_with_admin_session(ctx->connection, location, &ret)) return ret;
+    }
+    if (flash < 0 && has_session) {
+        if (serve_cached_page(ctx->connection, &admin_dashboard_cache) == MHD_YES) return MHD_YES;
+    }
+    PageBuffer page = {0};
+    generate_admin_dashboard_page(&page, has_session ? "" : ADMIN_PASS, flash >= 0 ? admin_flashes[flash].message : NULL);
+    return send_page(ctx->connection, &page, 200, "text/html");
+}
+
+static enum MHD_Result handle_admin_panel(RequestContext *ctx) {
+    const char *name = MHD_lookup_connection_value(ctx->connection, MHD_GET_ARGUMENT_KIND, "name");
+    for (int p = 0; name != NULL && p < NUM_DASHBOARD_PANELS; p++) {
+        if (strcmp(name, dashboard_panel_names[p]) != 0) continue;
+        if (p == PANEL_CONTROL && !request_has_admin_session(ctx->connection)) {
+            // A page without a session posts its forms with the password
+            PageBuffer page = {0};
+            generate_control_panel(&page, ADMIN_PASS);
+            return send_page(ctx->connection, &page, 200, "text/html");
+        }
+        if (serve_cached_page(ctx->connection, &dashboard_panel_caches[p]) == MHD_YES) return MHD_YES;
+        PageBuffer page = {0};
+        dashboard_panel_caches[p].render(&page);
+        return send_page(ctx->connection, &page, 200, "text/html");
+    }
+    return send_message_page(ctx->connection, 404, "Not Found", "There is no such dashboard panel.");
+}
+
+static enum MHD_Result handle_add_candidate(RequestContext *ctx) {
+    struct post_form *form = ctx->form;
+    enum admin_flash flash;
+    // MODIFIED: Check for party name
+    if (form->add_id[0] == '\0' || form->add_name[0] == '\0' || form->add_party[0] == '\0') {
+         flash = FLASH_CANDIDATE_FIELDS_MISSING;
+         form->error_flag = 5;
+    } else if (form->error_flag == 1) {
+        flash = FLASH_PHOTO_TOO_LARGE;
+    } else if (form->error_flag == 2) {
+        flash = FLASH_PHOTO_WRONG_TYPE;
+    } else if (form->error_flag == 3) {
+        flash = FLASH_PHOTO_WRITE_FAILED;
+    } else if (form->error_flag == 4 || form->original_filename[0] == '\0' ||
+               form->photo_upload == NULL) {
+        flash = FLASH_PHOTO_MISSING;
+    } else if (form->photo_upload->extension == NULL) {
+        flash = FLASH_PHOTO_WRONG_TYPE;
+    } else {
+        // Named after what the file is, not what the client called it
+        const char *ext = form->photo_upload->extension;
 
-            status_code = 200;
-        }
-    } else if (0 == strcmp(method, "GET")) {
-        if (0 == strcmp(url, "/")) {
-            load_candidates();
-            page = generate_voting_page(); 
-            status_code = 200;
-        } else if (0 == strcmp(url, "/admin")) {
-            page = generate_admin_login_page();
-            status_code = 200;
-        } 
-        else if (strncmp(url, "/images/", 8) == 0) {
-            if (serve_static_file(connection, url) == MHD_YES) {
-                return MHD_YES;
+        char final_filepath[256];
+        char url_path[256];
+
+        snprintf(final_filepath, sizeof(final_filepath), "%s/%s%s", UPLOAD_DIR, form->add_id, ext);
+        snprintf(url_path, sizeof(url_path), "/%s/%s%s", UPLOAD_DIR, form->add_id, ext);
+        
+        if (photo_upload_commit(form->photo_upload, final_filepath)) {
+            image_cache_invalidate(url_path);
+            // MODIFIED: Pass party name to function
+            if (add_new_candidate(form->add_id, form->add_name, form->add_party, url_path)) {
+                load_candidates(); 
+                flash = FLASH_CANDIDATE_ADDED;
             } else {
-                page = generate_message_page("Not Found", "The requested image does not exist.", 0);
-                status_code = 404;
+                flash = FLASH_CANDIDATE_SAVE_FAILED;
             }
-        }
-        else {
-            page = generate_message_page("Not Found", "The page you are looking for does not exist.", 0);
-            status_code = 404;
+        } else {
+            flash = FLASH_PHOTO_SAVE_FAILED;
+            perror("Saving uploaded photo failed");
         }
     }
+    return finish_admin_action(ctx, flash, PANEL_BIT(PANEL_ANALYTICS) | PANEL_BIT(PANEL_RESULTS));
+}
 
-    response = MHD_create_response_from_buffer(strlen(page), (void*)page, MHD_RESPMEM_MUST_COPY);
-    MHD_add_response_header(response, "Content-Type", "text/html");
-    enum MHD_Result ret = MHD_queue_response(connection, status_code, response);
+static enum MHD_Result handle_add_voter(RequestContext *ctx) {
+    struct post_form *form = ctx->form;
+    enum admin_flash flash;
+    if (form->add_voter_aadhar[0] == '\0' || form->add_voter_name[0] == '\0') {
+        flash = FLASH_VOTER_FIELDS_MISSING;
+    } else if (add_new_voter(form->add_voter_aadhar, form->add_voter_name)) {
+        flash = FLASH_VOTER_ADDED;
+    } else {
+        flash = FLASH_VOTER_SAVE_FAILED;
+    }
+    return finish_admin_action(ctx, flash, PANEL_BIT(PANEL_ANALYTICS) | REFRESH_VOTER_LIST);
+}
+
+// The import report names rejected rows, so it is not one of the canned
+// flash messages; plain form posts still get the dashboard rendered with it.
+static enum MHD_Result handle_import_voters(RequestContext *ctx) {
+    struct post_form *form = ctx->form;
+    char import_report[1024];
+    const char *flash_message = "Error: No voter file was uploaded.";
+    unsigned int status_code = 400;
+    if (form->voter_import != NULL) {
+        voter_import_finish(form->voter_import);
+        describe_voter_import(form->voter_import, import_report, sizeof(import_report));
+        flash_message = import_report;
+        status_code = form->voter_import->write_failed || form->voter_import->register_failed ? 500 : 200;
+    }
+    if (client_wants_json(ctx->connection)) {
+        return send_action_status(ctx->connection, status_code, flash_message, PANEL_BIT(PANEL_ANALYTICS) | REFRESH_VOTER_LIST);
+    }
+    return send_dashboard(ctx, flash_message);
+}
+
+static enum MHD_Result handle_start_election(RequestContext *ctx) {
+    save_election_state("LIVE");
+    return finish_admin_action(ctx, FLASH_ELECTION_STARTED, PANEL_BIT(PANEL_CONTROL));
+}
+
+static enum MHD_Result handle_stop_election(RequestContext *ctx) {
+    save_election_state("CLOSED");
+    return finish_admin_action(ctx, FLASH_ELECTION_STOPPED, PANEL_BIT(PANEL_CONTROL));
+}
+
+static enum MHD_Result handle_reset_election(RequestContext *ctx) {
+    enum admin_flash flash = FLASH_RESET_FAILED;
+    if (archive_votes_file()) {
+        save_election_state("PREP");
+        load_candidates();
+        flash = FLASH_ELECTION_RESET;
+    }
+    return finish_admin_action(ctx, flash, PANEL_BIT(PANEL_ANALYTICS) | PANEL_BIT(PANEL_CONTROL) |
+                                           PANEL_BIT(PANEL_RESULTS) | REFRESH_VOTER_LIST);
+}
+
+static enum MHD_Result handle_set_election_name(RequestContext *ctx) {
+    if (ctx->form->election_name[0] == '\0') {
+        return finish_admin_action(ctx, FLASH_NAME_EMPTY, 0);
+    }
+    save_election_name(ctx->form->election_name);
+    return finish_admin_action(ctx, FLASH_NAME_SET, PANEL_BIT(PANEL_CONTROL));
+}
+
+// Indexed by metric_route; ROUTE_OTHER has no handler and is answered with a 404
+static const Route routes[NUM_ROUTES] = {
+    [ROUTE_INDEX] = { METHOD_GET, AUTH_NONE, ADMIT_NONE, 1, handle_voting_page },
+    [ROUTE_ADMIN] = { METHOD_GET, AUTH_NONE, ADMIT_NONE, 1, handle_admin_login },
+    [ROUTE_ADMIN_VOTERS] = { METHOD_GET, AUTH_ADMIN_KEY, ADMIT_RENDER, 1, handle_voter_list },
+    [ROUTE_ADMIN_DASHBOARD] = { METHOD_GET, AUTH_ADMIN_KEY, ADMIT_RENDER, 1, handle_admin_dashboard },
+    [ROUTE_ADMIN_PANEL] = { METHOD_GET, AUTH_ADMIN_KEY, ADMIT_NONE, 1, handle_admin_panel },
+    [ROUTE_IMAGES] = { METHOD_GET, AUTH_NONE, ADMIT_NONE, 0, handle_image },
+    [ROUTE_API_RESULTS] = { METHOD_GET, AUTH_ADMIN_KEY_JSON, ADMIT_NONE, 1, handle_results_api },
+    [ROUTE_RESULTS_STREAM] = { METHOD_GET, AUTH_ADMIN_KEY, ADMIT_NONE, 1, handle_results_stream },
+    [ROUTE_METRICS] = { METHOD_GET, AUTH_NONE, ADMIT_NONE, 1, handle_metrics },
+    [ROUTE_SUBMIT_VOTE] = { METHOD_POST, AUTH_NONE, ADMIT_VOTE, 1, handle_submit_vote },
+    [ROUTE_RESULTS] = { METHOD_POST, AUTH_ADMIN_PASSWORD, ADMIT_RENDER, 1, handle_dashboard },
+    [ROUTE_ADD_CANDIDATE] = { METHOD_POST, AUTH_ADMIN_PASSWORD, ADMIT_CONTROL, 1, handle_add_candidate },
+    [ROUTE_ADD_VOTER] = { METHOD_POST, AUTH_ADMIN_PASSWORD, ADMIT_CONTROL, 1, handle_add_voter },
+    [ROUTE_IMPORT_VOTERS] = { METHOD_POST, AUTH_ADMIN_PASSWORD, ADMIT_RENDER, 1, handle_import_voters },
+    [ROUTE_START_ELECTION] = { METHOD_POST, AUTH_ADMIN_PASSWORD, ADMIT_CONTROL, 1, handle_start_election },
+    [ROUTE_STOP_ELECTION] = { METHOD_POST, AUTH_ADMIN_PASSWORD, ADMIT_CONTROL, 1, handle_stop_election },
+    [ROUTE_RESET_ELECTION] = { METHOD_POST, AUTH_ADMIN_PASSWORD, ADMIT_CONTROL, 1, handle_reset_election },
+    [ROUTE_SET_ELECTION_NAME] = { METHOD_POST, AUTH_ADMIN_PASSWORD, ADMIT_CONTROL, 1, handle_set_election_name },
+    [ROUTE_OTHER] = { 0, AUTH_NONE, ADMIT_NONE, 1, NULL },
+};
+
+static unsigned int method_bit(const char *method) {
+    if (strcmp(method, MHD_HTTP_METHOD_GET) == 0 || strcmp(method, MHD_HTTP_METHOD_HEAD) == 0) return METHOD_GET;
+    if (strcmp(method, MHD_HTTP_METHOD_POST) == 0) return METHOD_POST;
+    return 0;
+}
+
+static enum MHD_Result send_method_not_allowed(struct MHD_Connection *connection, unsigned int methods) {
+    static const char body[] = "<html><body><h1>Method Not Allowed</h1></body></html>";
+    struct MHD_Response *response = MHD_create_response_from_buffer(strlen(body), (void *)body, MHD_RESPMEM_PERSISTENT);
+    if (response == NULL) return MHD_NO;
+    MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_TYPE, "text/html");
+    MHD_add_response_header(response, MHD_HTTP_HEADER_ALLOW, (methods & METHOD_POST) ? "POST" : "GET, HEAD");
+    MHD_add_response_header(response, MHD_HTTP_HEADER_CONNECTION, "close"); // Do not read an unwanted body
+    enum MHD_Result ret = MHD_queue_response(connection, MHD_HTTP_METHOD_NOT_ALLOWED, response);
     MHD_destroy_response(response);
     return ret;
 }
 
+// Returns 1 if the request passes the route's admin check, otherwise queues
+// the refusal in *ret and returns 0.
+static int check_route_auth(const Route *route, RequestContext *ctx, enum MHD_Result *ret) {
+    switch (route->auth) {
+        case AUTH_NONE:
+            return 1;
+        case AUTH_ADMIN_KEY:
+        case AUTH_ADMIN_KEY_JSON:
+            if (request_has_admin_key(ctx->connection) || request_has_admin_session(ctx->connection)) return 1;
+            if (route->auth == AUTH_ADMIN_KEY_JSON) {
+                PageBuffer page = {0};
+                page_append(&page, "{\"error\":\"unauthorized\"}");
+                *ret = send_page(ctx->connection, &page, 401, "application/json");
+                return 0;
+            }
+            break;
+        case AUTH_ADMIN_PASSWORD:
+            if (admin_form_authorised(ctx->form)) return 1;
+            break;
+    }
+    *ret = send_message_page(ctx->connection, 403, "Access Denied", "The password you entered is incorrect.");
+    return 0;
+}
+
+// Feeds a POST body through the post processor. Returns 1 once the body is
+// complete, or 0 with *ret set while it is still arriving or was refused.
+static int collect_form(struct connection_info_struct *con_info, struct MHD_Connection *connection,
+                        const char *upload_data, size_t *upload_data_size, enum MHD_Result *ret) {
+    *ret = MHD_YES;
+    if (con_info->form == NULL) {
+        const FormSchema *schema = &form_schemas[con_info->route];
+        const char *length = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, MHD_HTTP_HEADER_CONTENT_LENGTH);
+        if (length != NULL && schema->max_body != 0 && strtoull(length, NULL, 10) > schema->max_body) {
+            *ret = queue_form_rejection(connection, 413);
+            return 0;
+        }
+        con_info->form = acquire_post_form();
+        if (con_info->form == NULL) {
+            *ret = MHD_NO;
+            return 0;
+        }
+        con_info->form->schema = schema;
+        // Read before the body, so uploads authorised by the cookie can stream
+        if (routes[con_info->route].auth == AUTH_ADMIN_PASSWORD) {
+            con_info->form->admin_session = request_has_admin_session(connection);
+        }
+    }
+    struct post_form *form = con_info->form;
+    if (*upload_data_size != 0) {
+        if (form_body_exceeds_limit(form, *upload_data_size)) {
+            *ret = queue_form_rejection(connection, 413);
+            return 0;
+        }
+        if (con_info->postprocessor == NULL) {
+            con_info->postprocessor = MHD_create_post_processor(connection, 8192, iterate_post, (void*)form);
+            if (NULL == con_info->postprocessor) {
+                *ret = MHD_NO; // request_completed releases con_info
+                return 0;
+            }
+        }
+        if (MHD_post_process(con_info->postprocessor, upload_data, *upload_data_size) != MHD_YES) {
+            // Schema violations are answered now; other errors are reported once the body ends
+            if (form->rejected != 0) {
+                *ret = queue_form_rejection(connection, form->rejected);
+                return 0;
+            }
+        }
+        *upload_data_size = 0;
+        return 0;
+    }
+
+    if (con_info->postprocessor) {
+        MHD_destroy_post_processor(con_info->postprocessor);
+        con_info->postprocessor = NULL;
+    }
+    form->aadhar[strcspn(form->aadhar, "\r\n")] = 0;
+    form->name[strcspn(form->name, "\r\n")] = 0;
+    form->add_id[strcspn(form->add_id, "\r\n")] = 0;
+    form->add_name[strcspn(form->add_name, "\r\n")] = 0;
+    form->add_party[strcspn(form->add_party, "\r\n")] = 0; // NEW
+    form->add_voter_aadhar[strcspn(form->add_voter_aadhar, "\r\n")] = 0;
+    form->add_voter_name[strcspn(form->add_voter_name, "\r\n")] = 0;
+    form->password[strcspn(form->password, "\r\n")] = 0;
+    form->election_name[strcspn(form->election_name, "\r\n")] = 0;
+    return 1;
+}
+
+static enum MHD_Result request_handler(void *cls, struct MHD_Connection *connection,
+                                     const char *url, const char *method,
+                                     const char *version, const char *upload_data,
+                                     size_t *upload_data_size, void **con_cls) {
+    
+    if (NULL == *con_cls) {
+        int route_id = classify_route(url);
+        const Route *route = &routes[route_id];
+        // Taken before any early answer, so request_completed counts and times those too
+        struct connection_info_struct *con_info = acquire_connection_info();
+        if (NULL == con_info) return MHD_NO;
+        con_info->route = route_id;
+        con_info->started_ns = monotonic_ns();
+        *con_cls = (void *)con_info;
+
+        int retry_after_s = route->rate_limited ? take_client_token(connection) : 0;
+        if (retry_after_s > 0) {
+            return queue_shed_response(connection, SHED_RATE_LIMITED, retry_after_s);
+        }
+        // Both are answered before any body is read
+        if (route->handler == NULL) {
+            return send_message_page(connection, 404, "Not Found", "The page you are looking for does not exist.");
+        }
+        if (!(route->methods & method_bit(method))) {
+            return send_method_not_allowed(connection, route->methods);
+        }
+        int shed_reason = SHED_RATE_LIMITED;
+        if (!reserve_admission(route->admission, &shed_reason)) {
+            return queue_shed_response(connection, shed_reason, 1);
+        }
+        con_info->admission = route->admission; // Released by request_completed
+        return MHD_YES;
+    }
+
+    struct connection_info_struct *con_info = *con_cls;
+    const Route *route = &routes[con_info->route];
+    RequestContext ctx = { connection, con_info, NULL, url };
+    enum MHD_Result ret;
+    if (route->methods & METHOD_POST) {
+        if (!collect_form(con_info, connection, upload_data, upload_data_size, &ret)) return ret;
+        ctx.form = con_info->form;
+    }
+    if (!check_route_auth(route, &ctx, &ret)) return ret;
+    return route->handler(&ctx);
+}
 
 int main(int argc, char *argv[]) {
     #ifdef _WIN32
@@ -1412,11 +5821,54 @@ int main(int argc, char *argv[]) {
     #endif
 
     int port = DEFAULT_PORT;
-    if (argc > 1) {
-        port = atoi(argv[1]);
-        if (port <= 0 || port > 65535) {
-            fprintf(stderr, "Invalid port number '%s'. Using default %d.\n", argv[1], DEFAULT_PORT);
-            port = DEFAULT_PORT;
+    int thread_pool_size = DEFAULT_THREAD_POOL_SIZE;
+    int max_connections = DEFAULT_MAX_CONNECTIONS;
+    int connection_timeout_s = DEFAULT_CONNECTION_TIMEOUT_S;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--threads=", 10) == 0) {
+            thread_pool_size = atoi(argv[i] + 10);
+            if (thread_pool_size < 1) {
+                fprintf(stderr, "Invalid thread count '%s'. Using 1.\n", argv[i] + 10);
+                thread_pool_size = 1;
+            }
+        } else if (strncmp(argv[i], "--commit-window-us=", 19) == 0) {
+            ledger_commit_window_us = atol(argv[i] + 19);
+            if (ledger_commit_window_us < 0) ledger_commit_window_us = 0;
+        } else if (strcmp(argv[i], "--convert-voters") == 0) {
+            return convert_voter_registry() ? 0 : 1;
+        } else if (strncmp(argv[i], "--ledger-shards=", 16) == 0) {
+            ledger_shard_count = atoi(argv[i] + 16);
+            if (ledger_shard_count < 1 || ledger_shard_count > LEDGER_MAX_SHARDS) {
+                fprintf(stderr, "--ledger-shards must be between 1 and %d. Using %d.\n", LEDGER_MAX_SHARDS, DEFAULT_LEDGER_SHARDS);
+                ledger_shard_count = DEFAULT_LEDGER_SHARDS;
+            }
+        } else if (strncmp(argv[i], "--checkpoint-interval-s=", 24) == 0) {
+            checkpoint_interval_s = atol(argv[i] + 24);
+            if (checkpoint_interval_s < 0) checkpoint_interval_s = 0;
+        } else if (strncmp(argv[i], "--results-interval-ms=", 22) == 0) {
+            results_stream_interval_ms = atol(argv[i] + 22);
+            if (results_stream_interval_ms < 0) results_stream_interval_ms = 0;
+        } else if (strncmp(argv[i], "--client-rate=", 14) == 0) {
+            client_rate = atol(argv[i] + 14);
+            if (client_rate < 0) client_rate = 0;
+        } else if (strncmp(argv[i], "--max-pending-votes=", 20) == 0) {
+            max_pending_votes = atol(argv[i] + 20);
+            if (max_pending_votes < 1) max_pending_votes = 1;
+        } else if (strncmp(argv[i], "--max-renders=", 14) == 0) {
+            max_active_renders = atol(argv[i] + 14);
+            if (max_active_renders < 1) max_active_renders = 1;
+        } else if (strncmp(argv[i], "--max-connections=", 18) == 0) {
+            max_connections = atoi(argv[i] + 18);
+            if (max_connections < 1) max_connections = DEFAULT_MAX_CONNECTIONS;
+        } else if (strncmp(argv[i], "--connection-timeout-s=", 23) == 0) {
+            connection_timeout_s = atoi(argv[i] + 23);
+            if (connection_timeout_s < 0) connection_timeout_s = 0;
+        } else {
+            port = atoi(argv[i]);
+            if (port <= 0 || port > 65535) {
+                fprintf(stderr, "Invalid port number '%s'. Using default %d.\n", argv[i], DEFAULT_PORT);
+                port = DEFAULT_PORT;
+            }
         }
     }
 
@@ -1450,26 +5902,88 @@ int main(int argc, char *argv[]) {
     load_election_state();
     load_election_name(); 
     load_candidates();
+    load_voter_registry();
+    LedgerPosition checkpoint_positions[LEDGER_MAX_SHARDS];
+    if (load_checkpoint(checkpoint_positions)) {
+        replay_ballot_ledger(checkpoint_positions);
+    } else {
+        get_vote_counts();
+        load_voted_set();
+        replay_legacy_ballots();
+        replay_ballot_ledger(NULL);
+    }
+    if (!open_ballot_ledger()) {
+        return 1;
+    }
+    if (!start_checkpoints()) {
+        close_ballot_ledger();
+        return 1;
+    }
     struct MHD_Daemon *daemon;
 
-    daemon = MHD_start_daemon(MHD_USE_SELECT_INTERNALLY, port, NULL, NULL,
+    // Each pool thread runs its own epoll loop over a share of the connections
+    #ifdef __linux__
+        unsigned int daemon_flags = MHD_USE_EPOLL_INTERNAL_THREAD;
+    #else
+        unsigned int daemon_flags = MHD_USE_SELECT_INTERNALLY;
+    #endif
+    daemon_flags |= MHD_ALLOW_SUSPEND_RESUME; // Idle results streams and pending ballots are parked
+    daemon_flags |= MHD_USE_ITC; // Lets shutdown quiesce the listening thread
+    if (!start_results_stream()) {
+        close_ballot_ledger();
+        stop_checkpoints();
+        return 1;
+    }
+    daemon = MHD_start_daemon(daemon_flags, port, NULL, NULL,
                               &request_handler, NULL,
                               MHD_OPTION_NOTIFY_COMPLETED, &request_completed, NULL,
+                              MHD_OPTION_NOTIFY_CONNECTION, &connection_notify, NULL,
+                              MHD_OPTION_THREAD_POOL_SIZE, (unsigned int)thread_pool_size,
+                              MHD_OPTION_CONNECTION_LIMIT, (unsigned int)max_connections,
+                              MHD_OPTION_CONNECTION_TIMEOUT, (unsigned int)connection_timeout_s,
                               MHD_OPTION_END);
     if (NULL == daemon) {
         fprintf(stderr, "Failed to start server\n");
+        stop_results_stream();
+        free_results_stream();
+        close_ballot_ledger();
+        stop_checkpoints();
         return 1;
     }
 
-    printf("Server is running on http://localhost:%d\n", port);
+    printf("Server is running on http://localhost:%d with %d worker thread(s)\n", port, thread_pool_size);
     printf("Press Enter to quit...\n");
     getchar();
 
+    // No connection may still be suspended when MHD_stop_daemon runs
+    stop_results_stream();
+    MHD_socket listen_socket = MHD_quiesce_daemon(daemon);
+    drain_parked_ballots();
     MHD_stop_daemon(daemon);
+    if (listen_socket != MHD_INVALID_SOCKET) {
+        #ifdef _WIN32
+            closesocket(listen_socket);
+        #else
+            close(listen_socket);
+        #endif
+    }
+    free_results_stream();
+    close_ballot_ledger();
+    stop_checkpoints();
+    release_cached_responses(&voting_page_cache);
+    release_cached_responses(&admin_login_cache);
+    release_cached_responses(&results_api_cache);
+    release_cached_responses(&admin_dashboard_cache);
+    for (int p = 0; p < NUM_DASHBOARD_PANELS; p++) release_cached_responses(&dashboard_panel_caches[p]);
+    release_image_cache();
 
     if (candidates != NULL) {
         free(candidates);
     }
+    free(candidate_slot_by_id);
+    pthread_rwlock_wrlock(&voters_lock);
+    free_voter_registry();
+    pthread_rwlock_unlock(&voters_lock);
 
     #ifdef _WIN32
         WSACleanup();